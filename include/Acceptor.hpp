@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+
+#include <Channel.hpp>
+#include <Socket.hpp>
+
+class EventLoop;
+class InetAddress;
+
+// 运行在mainloop中 监听listenfd 接受新连接后交给TcpServer
+class Acceptor
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
+
+    Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    ~Acceptor();
+
+    Acceptor(const Acceptor &) = delete;
+    Acceptor &operator=(const Acceptor &) = delete;
+
+    // 没有设置时接受的连接直接关闭
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+
+    bool listenning() const { return listenning_; }
+    void listen();
+
+private:
+    // listenfd可读 一次最多接受kMaxAcceptsPerEvent个连接
+    void handleRead();
+
+    EventLoop *loop_;
+    Socket acceptSocket_;
+    Channel acceptChannel_;
+    NewConnectionCallback newConnectionCallback_;
+    bool listenning_;
+    int idleFd_; // 预留的fd 文件描述符耗尽(EMFILE)时用它接受并立即关闭连接 避免listenfd一直可读
+};
@@ -1,54 +1,262 @@
 #pragma once
-#include <FixedBuffer.hpp>
+#include <BinaryLog.hpp>
+#include <LogCompressor.hpp>
+#include <LogIndex.hpp>
+#include <Logger.hpp>
+#include <SpscRing.hpp>
+#include <Thread.hpp>
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <sys/uio.h>
+#include <vector>
 
-class AsynLogging
+class LogFile;
+
+/**
+ * 异步日志 前端线程只写内存 后端线程负责写文件
+ * 1. 每个写日志的线程第一次写日志时分配一个自己的SPSC环形缓冲区 之后写日志不加任何锁
+ *    多个loop线程同时打日志不会再争抢同一把mutex
+ * 2. 作为LogSink使用时(Logger::setSink) Logger直接在环形缓冲区中预留的位置上格式化 每条日志只写一次
+ * 3. 后端线程被唤醒(某个缓冲区超过一半或者FATAL)或者每flushInterval秒 收集所有缓冲区中的日志
+ *    直接引用缓冲区中的记录 用一次pwritev写入LogFile 写完之后才释放缓冲区空间 日志不再经过stdio拷贝
+ * 4. 缓冲区满时按setOverloadPolicy的策略处理 默认唤醒后端并等待空间 不丢日志
+ *    丢弃的条数由后端以"dropped N log messages"的WARN日志写入文件
+ * 5. 线程退出后 它的缓冲区在后端写完剩余日志后放回缓冲池(池满时释放)
+ *    setBufferPool可以在启动时预先分配缓冲区 并限制缓冲区总数 内存有上限
+ * 6. setCrashSafeBuffers(true)后缓冲区映射到文件 进程崩溃时还没写出的日志留在文件中
+ *    下次start()时写入新的日志文件 也可以用tools/LogRecover直接取出 因此可以放心调大flushInterval
+ * 7. setCompression后滚动下来的日志文件由LogCompressor在后台压缩 后端线程不等待
+ * 8. setTimeIndex后每个日志文件带一个稀疏时间索引(LogIndex.hpp) tools/LogQuery按时间段取日志
+ * 9. 二进制日志(BinaryLog.hpp)的记录默认由后端线程格式化成文本
+ *    setBinaryOutput(true)后原样写入文件 由tools/LogDecoder离线解码
+ **/
+class AsynLogging : public LogSink
 {
 public:
+    static const size_t kDefaultThreadBufferSize = 1024 * 1024; // 每个线程的缓冲区大小
+
+    // 缓冲区满时的处理策略
+    enum OverloadPolicy
+    {
+        kBlock,  // 唤醒后端并等待空间 不丢日志 写日志的线程可能被磁盘拖慢
+        kDrop,   // 丢弃并计数 写日志的线程从不等待
+        kSample, // 缓冲区超过3/4后每sampleEvery条只保留一条 满了之后丢弃
+    };
+
     AsynLogging(const std::string &basename, off_t rollSize,
-                int flushInterval = 3);
-    ~AsynLogging()
+                int flushInterval = 3,
+                size_t threadBufferSize = kDefaultThreadBufferSize);
+    ~AsynLogging() override
     {
         if (running_)
         {
             stop();
         }
     }
-    // 前端调用append写入日志
+    // 前端调用append写入日志 拷贝一次到当前线程的缓冲区
     void append(const char *logline, int len);
 
+    // LogSink接口 在当前线程的缓冲区中预留/提交 后端没有运行时reserve返回nullptr
+    char *reserve(size_t len) override;
+    void commit(const char *data, size_t len, uint32_t kind = 0) override;
+    // 唤醒后端 等待此前提交的日志写入文件(最多等待1秒)
+    void flush() override;
+
+    /**
+     * 以二进制格式写日志文件 必须在start()之前调用
+     * 文件由带8字节头(长度+类型)的记录组成 每个文件以文件头开始 在第一次用到某个调用点之前写入它的定义
+     * 所以每个文件都可以单独解码 文本日志也按记录写入
+     */
+    void setBinaryOutput(bool on) { binaryOutput_ = on; }
+
+    // 设置缓冲区满时的策略 可以随时调用
+    void setOverloadPolicy(OverloadPolicy policy, int sampleEvery = 16)
+    {
+        sampleEvery_.store(sampleEvery > 1 ? sampleEvery : 1, std::memory_order_relaxed);
+        policy_.store(policy, std::memory_order_relaxed);
+    }
+
+    /**
+     * 缓冲池 必须在start()之前调用
+     * @param poolSize start()时预先分配的缓冲区个数 线程退出后最多保留这么多空闲缓冲区以供复用
+     * @param maxBuffers 缓冲区总数上限 0表示不限 达到上限后新线程的日志被丢弃并计数 直到有缓冲区空闲
+     */
+    void setBufferPool(size_t poolSize, size_t maxBuffers)
+    {
+        poolSize_ = poolSize;
+        maxBuffers_ = maxBuffers;
+    }
+
+    /**
+     * 缓冲区映射到文件basename.ring.N(MAP_SHARED) 必须在start()之前调用
+     * 进程崩溃后没写出的记录仍在文件中 start()时先取出上次运行留下的文本日志写入日志文件
+     * 二进制日志记录依赖上次运行的调用点登记表 无法还原 只计数
+     * 只防进程崩溃 basename放在/dev/shm等内存文件系统下时缓冲区不会被回写磁盘
+     */
+    void setCrashSafeBuffers(bool on) { crashSafe_ = on; }
+
+    /**
+     * 滚动后的日志文件在后台压缩成.gz 必须在start()之前调用 参数见LogCompressor
+     * 停止时最后一个文件也会被压缩 析构时等待压缩完成
+     */
+    void setCompression(int level, size_t keepFiles = 0, off_t keepBytes = 0)
+    {
+        compressor_.reset(new LogCompressor(basename_, level, keepFiles, keepBytes));
+    }
+    /**
+     * 为每个日志文件生成时间索引xxx.log.idx 必须在start()之前调用
+     * 每写bytes字节或者每秒一项 记录这一块日志的时间范围 压缩时一起转换成.gz中的位置
+     * 时间取自文本日志行首的时间和二进制记录的时间戳 二进制输出(setBinaryOutput)时不生成索引
+     */
+    void setTimeIndex(off_t bytes = 64 * 1024) { indexInterval_ = bytes; }
+
+    // 没有调用setCompression时返回nullptr 可以用stats()查看压缩积压
+    const LogCompressor *compressor() const { return compressor_.get(); }
+
+    // 已经写入文件的丢弃条数
+    uint64_t droppedMessages() const { return droppedMessages_.load(std::memory_order_relaxed); }
+
     void start()
     {
+        if (crashSafe_)
+        {
+            recoverBuffers();
+        }
         running_ = true;
+        preallocateBuffers();
         thread_.start();
     }
 
     void stop()
     {
         running_ = false;
-        cond_.notify_one();
+        wakeupBackend();
+        thread_.join();
     }
 
 private:
-    using LargeBuffer = FixedBuffer<kLargeBufferSize>;
-    using BufferVector = std::vector<std::unique_ptr<LargeBuffer>>;
-    // BufferVector::value_type 是 std::vector<std::unique_ptr<Buffer>>
-    // 的元素类型，也就是 std::unique_ptr<Buffer>。
-    using BufferPtr = BufferVector::value_type;
+    // 一个前端线程的缓冲区 由该线程的thread_local和后端共同持有
+    struct ThreadBuffer
+    {
+        ThreadBuffer(size_t capacity, const std::string &path)
+            : ring(capacity, path), closed(false), wakeupSent(false), dropped(0),
+              tid(0), lastUsed(0), sampleCount(0) {}
+        SpscRing ring;
+        std::atomic<bool> closed;       // 所属线程已经退出
+        std::atomic<bool> wakeupSent;   // 已经唤醒过后端 后端取走日志后清除
+        std::atomic<uint64_t> dropped;  // 丢弃的条数 后端写出标记后清零
+        int tid;                        // 所属线程
+        size_t lastUsed;                // 上次commit后估计的已用字节数 只有所属线程访问
+        unsigned sampleCount;           // kSample的计数 只有所属线程访问
+    };
+    using ThreadBufferPtr = std::shared_ptr<ThreadBuffer>;
+
+    // 线程缓存的缓冲区 线程退出时标记缓冲区closed
+    struct ThreadBufferCache
+    {
+        ~ThreadBufferCache()
+        {
+            if (buffer)
+            {
+                buffer->closed.store(true, std::memory_order_release);
+            }
+        }
+        uint64_t owner = 0; // 缓冲区所属的AsynLogging的id_
+        ThreadBufferPtr buffer;
+        std::vector<char> discard; // 要丢弃的日志格式化到这里 commit时直接忽略
+    };
+    static thread_local ThreadBufferCache t_threadBuffer_;
+
+    // 当前线程在本对象中的缓冲区 第一次调用时创建并登记 达到上限时返回nullptr
+    ThreadBuffer *threadBuffer();
+    // 从缓冲池中取一个缓冲区 或者在上限之内新分配一个
+    ThreadBufferPtr acquireBuffer();
+    void preallocateBuffers();
+    // 新缓冲区的映射文件名 不映射文件时为空 调用时持有mutex_
+    std::string nextBufferPath();
+    // 取出上次运行留在映射文件中的日志 放到recovered_中
+    void recoverBuffers();
+    // 丢弃一条日志 返回给调用者格式化用的临时内存
+    char *discard(ThreadBuffer *buffer, size_t len);
+    // 把丢弃的条数写成一条WARN日志
+    void queueDropMarker(LogFile &output, uint64_t dropped, int tid);
+    // 把后端自己产生的文本加入本轮要写的数据 二进制输出时加上文本记录头
+    void queueText(LogFile &output, const char *data, size_t len);
+    void wakeupBackend();
     void threadFunc();
+    // 取出所有缓冲区中的日志写入output 返回写入的条数
+    size_t drainBuffers(const std::vector<ThreadBufferPtr> &buffers, LogFile &output);
+    // 把一条缓冲区中的记录加入本轮要写的数据 data为记录内容 紧挨在它前面的是8字节的记录头
+    // 二进制记录的时钟读数在这里原地换算成微秒
+    void writeRecord(LogFile &output, char *data, size_t len, uint32_t kind);
+    // 二进制输出: 保证当前文件已经写过文件头和siteId的定义
+    void prepareBinaryFile(LogFile &output, uint32_t siteId);
+    // 把data开始的len字节加入本轮要写的数据 与上一段相邻时合并
+    void queueOutput(const char *data, size_t len);
+    // 把scratch_末尾刚追加的len字节加入本轮要写的数据
+    void queueScratch(size_t len);
+    // 一次写出本轮收集的数据
+    void writeBatch(LogFile &output);
+    // 把一条日志的时间并入当前索引块的时间范围
+    void noteTime(int64_t micros)
+    {
+        batchMinTime_ = std::min(batchMinTime_, micros);
+        batchMaxTime_ = std::max(batchMaxTime_, micros);
+    }
+    // 文本日志的时间取自行首
+    void noteTextTime(const char *data, size_t len);
+    // 本轮已经收集的数据超过索引块大小时在这里切分 一轮的数据可能有几MB 分块写入才能得到有用的索引
+    void cutIndexBlock();
+
     const int flushInterval_; // 日志刷新时间
     std::atomic<bool> running_;
     const std::string basename_;
     off_t rollSize_;
-    bool running_;
+    const size_t threadBufferSize_;
+    const uint64_t id_; // 区分不同的AsynLogging对象 线程缓存的缓冲区属于哪个对象
     Thread thread_;
     std::mutex mutex_;
     std::condition_variable cond_;
+    bool wakeupRequested_;                // 有前端请求后端立即处理 由mutex_保护
+    std::vector<ThreadBufferPtr> buffers_; // 所有前端线程的缓冲区 由mutex_保护
+    std::vector<ThreadBufferPtr> freeBuffers_; // 空闲的缓冲区 由mutex_保护
+    size_t numBuffers_;                   // 已分配的缓冲区总数 由mutex_保护
+    size_t poolSize_;
+    size_t maxBuffers_;
+    bool crashSafe_;                      // 缓冲区是否映射到文件
+    uint64_t nextBufferFile_;             // 下一个映射文件的编号 由mutex_保护
+    std::string recovered_;               // 上次运行留下的日志 后端启动后先写出
+    std::unique_ptr<LogCompressor> compressor_; // 滚动后文件的压缩 为nullptr时不压缩
+    off_t indexInterval_;                 // 时间索引的块大小 0表示不生成索引
+    std::atomic<size_t> numFree_;         // freeBuffers_.size() 前端不加锁判断是否值得再去取
+    std::atomic<int> policy_;
+    std::atomic<int> sampleEvery_;
+    std::atomic<uint64_t> unbufferedDrops_; // 没有缓冲区的线程丢弃的条数
+    std::atomic<uint64_t> droppedMessages_;
+    std::atomic<uint64_t> drainRounds_;   // 后端完成的处理轮数 用于flush()等待
 
-    BufferPtr currentBuffer_;
-    BufferPtr nextBuffer_;
-    BufferVector buffers_;
-};
\ No newline at end of file
+    // 以下只在后端线程中访问
+    bool binaryOutput_;               // 是否以二进制格式写文件
+    std::vector<struct iovec> iov_;   // 本轮要写的数据 iov_base为nullptr的段依次位于scratch_中
+    std::vector<uint64_t> drainEnds_; // 每个缓冲区本轮处理到的位置 写完之后释放
+    std::string scratch_;             // 本轮格式化的二进制记录/文件头/调用点定义
+    BinaryLog::ClockConverter clock_; // 二进制记录的时钟换算 每轮校准一次
+    int headerFile_;                  // 已经写过文件头的文件(LogFile::fileCount)
+    std::vector<int> siteFiles_;      // 调用点id => 已经写过其定义的文件
+    LogIndex::TimeParser timeParser_; // 解析文本日志行首的时间
+    int64_t batchMinTime_;            // 本轮日志中最早的时间 没有时为INT64_MAX
+    int64_t batchMaxTime_;            // 本轮日志中最晚的时间 没有时为INT64_MIN
+    // 本轮数据中的一个索引块: iov_中到iovEnd为止的段 以及这些日志的时间范围
+    struct IndexBlock
+    {
+        size_t iovEnd;
+        int64_t minTime;
+        int64_t maxTime;
+    };
+    std::vector<IndexBlock> indexBlocks_; // 本轮已经切分出来的索引块
+    size_t blockBytes_;                   // 上次切分之后收集的字节数
+};
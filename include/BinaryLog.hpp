@@ -0,0 +1,319 @@
+#pragma once
+#include <CurrentThread.hpp>
+#include <Logger.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+/**
+ * 二进制延迟格式化日志(参考NanoLog)
+ * 1. 每个日志调用点(格式串、文件、行号、等级、参数类型)第一次执行时登记一次 得到调用点id
+ * 2. 热路径上只写一条紧凑的二进制记录: 调用点id + tid + 时钟读数 + 参数的原始字节
+ *    不做任何整数/浮点/时间的格式化 字符串参数按长度拷贝
+ *    x86上有不变TSC时时钟读数就是rdtsc 比gettimeofday便宜 由后端线程用ClockConverter换算成微秒
+ * 3. 记录经由Logger::setSink设置的后端(AsynLogging)的线程缓冲区传给后端线程
+ *    后端线程把它格式化成文本写入文件 或者以二进制写入文件 再用tools/LogDecoder离线还原成文本
+ * 4. 没有设置后端时在当前线程直接格式化成文本 经由OutputFunc输出
+ *
+ * 用法: BINLOG_INFO("conn fd=%d read %zu bytes in %.3f ms", fd, n, ms);
+ * 格式串使用printf的语法 编译期按printf检查参数类型 不支持*宽度/精度和%n
+ * std::string参数需要传.c_str()(按%s检查) 记录时只拷贝字符串内容
+ **/
+
+// 调用点 由BINLOG_XXX宏定义为函数内的静态对象 每个调用点一个
+struct BinaryLogSite
+{
+    BinaryLogSite(Logger::LogLevel lvl, const char *srcFile, int srcLine, const char *fmt)
+        : level(lvl), file(srcFile), line(srcLine), format(fmt), argTypes(""), id(0) {}
+
+    Logger::LogLevel level;
+    const char *file;
+    int line;
+    const char *format;
+    const char *argTypes;     // 每个参数一个类型码 见BinaryLog::TypeCode
+    std::atomic<uint32_t> id; // 0表示还没有登记
+};
+
+namespace BinaryLog
+{
+    // 后端缓冲区中的记录类型 与LogSink::commit的kind对应
+    enum RecordKind : uint32_t
+    {
+        kTextRecord = 0,   // 已经格式化好的文本
+        kBinaryRecord = 1, // 二进制日志记录
+        kSiteRecord = 2,   // 调用点定义 只出现在二进制日志文件中
+        kMagicRecord = 3,  // 二进制日志文件头
+    };
+
+    // 二进制日志文件的第一条记录的内容
+    const char kFileMagic[] = "webserver-binlog-v1";
+
+    // 二进制记录的固定头部 后面紧跟各个参数
+    // 前端写入的timestamp是clockNow()的读数 交给后端之后由后端换算成微秒 文件中保存的都是微秒
+    struct RecordHeader
+    {
+        uint32_t siteId;
+        uint32_t tid;
+        int64_t timestamp;
+    };
+
+    // 是否使用TSC作为时钟 程序启动时按CPU是否支持不变TSC确定
+    extern const bool kUseTsc;
+
+    // 热路径上的时钟读数 TSC或者微秒
+    inline int64_t clockNow()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (kUseTsc)
+        {
+            return static_cast<int64_t>(__builtin_ia32_rdtsc());
+        }
+#endif
+        return Timestamp::now().microSecondsSinceEpoch();
+    }
+
+    /**
+     * 把clockNow()的读数换算成微秒 每个后端线程一个 不是线程安全的
+     * 构造时用约1ms估算TSC频率 之后每次recalibrate()以当前时刻为锚点并用更长的区间修正频率
+     * 换算结果不会随时间漂移 不使用TSC时原样返回
+     */
+    class ClockConverter
+    {
+    public:
+        ClockConverter();
+        void recalibrate();
+        int64_t toMicroseconds(int64_t clock) const
+        {
+            if (!kUseTsc)
+            {
+                return clock;
+            }
+            return anchorMicros_ + static_cast<int64_t>(static_cast<double>(clock - anchorTicks_) / ticksPerMicro_);
+        }
+
+    private:
+        int64_t startTicks_;   // 第一个锚点
+        int64_t startMicros_;
+        int64_t anchorTicks_;  // 最近的锚点
+        int64_t anchorMicros_;
+        double ticksPerMicro_; // TSC频率
+    };
+
+    const uint32_t kMaxSites = 16384; // 最多登记的调用点个数 超出的调用点退化为直接格式化
+
+    // 登记调用点并设置参数类型 返回id 调用点已满时返回0 线程安全
+    uint32_t registerSite(BinaryLogSite *site, const char *argTypes);
+    // 按id查找调用点 不加锁
+    const BinaryLogSite *findSite(uint32_t id);
+
+    /**
+     * 把一条二进制记录的参数按格式串格式化 追加到out中
+     * args/len为RecordHeader之后的参数字节 参数不足或类型不匹配时原样输出转换说明
+     */
+    void formatMessage(const char *format, const char *argTypes,
+                       const char *args, size_t len, std::string &out);
+    /**
+     * 把一条完整的二进制记录格式化成一行文本(含时间、tid、等级、文件名和行号) 追加到out中
+     * header.timestamp必须已经是微秒 site为nullptr时按未知调用点输出
+     */
+    void formatRecord(const BinaryLogSite *site, const RecordHeader &header,
+                      const char *args, size_t len, std::string &out);
+
+    // 参数类型码
+    enum TypeCode : char
+    {
+        kInt8 = 'b',
+        kUInt8 = 'B',
+        kInt16 = 'h',
+        kUInt16 = 'H',
+        kInt32 = 'i',
+        kUInt32 = 'I',
+        kInt64 = 'l',
+        kUInt64 = 'L',
+        kDouble = 'd',
+        kChar = 'c',
+        kBool = 'o',
+        kString = 's', // 4字节长度+内容 不含结尾的'\0'
+        kPointer = 'p',
+    };
+
+    // 参数类型 => 类型码
+    template <typename T, typename Enable = void>
+    struct TypeOf;
+
+    template <typename T>
+    struct TypeOf<T, typename std::enable_if<std::is_integral<T>::value &&
+                                             !std::is_same<T, bool>::value &&
+                                             !std::is_same<T, char>::value>::type>
+    {
+        static constexpr char value =
+            sizeof(T) == 1 ? (std::is_signed<T>::value ? kInt8 : kUInt8)
+            : sizeof(T) == 2 ? (std::is_signed<T>::value ? kInt16 : kUInt16)
+            : sizeof(T) == 4 ? (std::is_signed<T>::value ? kInt32 : kUInt32)
+                             : (std::is_signed<T>::value ? kInt64 : kUInt64);
+    };
+    template <typename T>
+    struct TypeOf<T, typename std::enable_if<std::is_enum<T>::value>::type>
+        : TypeOf<typename std::underlying_type<T>::type> {};
+    template <typename T>
+    struct TypeOf<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static constexpr char value = kDouble;
+    };
+    template <>
+    struct TypeOf<char>
+    {
+        static constexpr char value = kChar;
+    };
+    template <>
+    struct TypeOf<bool>
+    {
+        static constexpr char value = kBool;
+    };
+    template <>
+    struct TypeOf<const char *>
+    {
+        static constexpr char value = kString;
+    };
+    template <>
+    struct TypeOf<char *>
+    {
+        static constexpr char value = kString;
+    };
+    template <>
+    struct TypeOf<std::string>
+    {
+        static constexpr char value = kString;
+    };
+    template <typename T>
+    struct TypeOf<T *, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    {
+        static constexpr char value = kPointer;
+    };
+
+    template <typename T>
+    using Decay = typename std::decay<T>::type;
+
+    // 所有参数的类型码组成的字符串 每种参数组合一份静态存储
+    template <typename... Args>
+    struct TypeString
+    {
+        static constexpr char value[sizeof...(Args) + 1] = {TypeOf<Decay<Args>>::value..., '\0'};
+    };
+
+    // 参数编码后的字节数
+    inline size_t argSize(const char *s) { return sizeof(uint32_t) + (s ? ::strlen(s) : 0); }
+    inline size_t argSize(char *s) { return argSize(static_cast<const char *>(s)); }
+    inline size_t argSize(const std::string &s) { return sizeof(uint32_t) + s.size(); }
+    template <typename T>
+    size_t argSize(const T &)
+    {
+        return TypeOf<Decay<T>>::value == kDouble ? sizeof(double) : sizeof(T);
+    }
+
+    // 写入一个参数 返回写入后的位置
+    inline char *encodeString(char *dst, const char *data, size_t len)
+    {
+        uint32_t n = static_cast<uint32_t>(len);
+        ::memcpy(dst, &n, sizeof(n));
+        ::memcpy(dst + sizeof(n), data, len);
+        return dst + sizeof(n) + len;
+    }
+    inline char *encodeArg(char *dst, const char *s) { return encodeString(dst, s, s ? ::strlen(s) : 0); }
+    inline char *encodeArg(char *dst, char *s) { return encodeArg(dst, static_cast<const char *>(s)); }
+    inline char *encodeArg(char *dst, const std::string &s) { return encodeString(dst, s.data(), s.size()); }
+    template <typename T>
+    char *encodeArg(char *dst, const T &value)
+    {
+        if constexpr (std::is_floating_point<T>::value)
+        {
+            double d = static_cast<double>(value); // float统一按double保存
+            ::memcpy(dst, &d, sizeof(d));
+            return dst + sizeof(d);
+        }
+        else
+        {
+            ::memcpy(dst, &value, sizeof(value));
+            return dst + sizeof(value);
+        }
+    }
+
+    // 没有后端或者后端不可用时 直接格式化成文本输出
+    void writeText(const BinaryLogSite *site, const char *args, size_t len);
+
+    // 在record处写入记录头和参数
+    template <typename... Args>
+    void encodeRecord(char *record, uint32_t id, int64_t clock, const Args &...args)
+    {
+        RecordHeader header;
+        header.siteId = id;
+        header.tid = static_cast<uint32_t>(CurrentThread::tid());
+        header.timestamp = clock;
+        ::memcpy(record, &header, sizeof(header));
+        char *cur = record + sizeof(header);
+        ((cur = encodeArg(cur, args)), ...);
+    }
+
+    // 没有后端时的慢路径 编码到栈上再格式化 不内联 不占用热路径的栈和指令缓存
+    template <typename... Args>
+    __attribute__((noinline)) void writeSlow(BinaryLogSite &site, uint32_t id, size_t len,
+                                             const Args &...args)
+    {
+        char record[kSmallBufferSize];
+        if (len > sizeof(record))
+        {
+            return; // 参数太长又没有后端 放弃这条日志
+        }
+        // 当场格式化 直接记录微秒
+        encodeRecord(record, id, Timestamp::now().microSecondsSinceEpoch(), args...);
+        writeText(&site, record, len);
+    }
+
+    template <typename... Args>
+    void write(BinaryLogSite &site, const Args &...args)
+    {
+        uint32_t id = site.id.load(std::memory_order_acquire);
+        if (id == 0)
+        {
+            id = registerSite(&site, TypeString<Args...>::value);
+        }
+        size_t len = sizeof(RecordHeader);
+        ((len += argSize(args)), ...);
+
+        LogSink *backend = g_sink;
+        char *data = (backend && id != 0) ? backend->reserve(len) : nullptr;
+        if (data == nullptr)
+        {
+            writeSlow(site, id, len, args...);
+            return;
+        }
+        encodeRecord(data, id, clockNow(), args...);
+        backend->commit(data, len, kBinaryRecord);
+    }
+
+    // 只用于让编译器按printf检查格式串和参数 从不调用
+    inline void checkFormat(const char *, ...) __attribute__((format(printf, 1, 2)));
+    inline void checkFormat(const char *, ...) {}
+} // namespace BinaryLog
+
+#define BINLOG_IF_ENABLED(level, format, ...)                                  \
+    do                                                                         \
+    {                                                                          \
+        if ((level) >= LOG_MIN_LEVEL && g_thisLogModule.enabled(level))        \
+        {                                                                      \
+            if (false)                                                         \
+            {                                                                  \
+                BinaryLog::checkFormat(format, ##__VA_ARGS__);                 \
+            }                                                                  \
+            static BinaryLogSite binlogSite(level, __FILE__, __LINE__, format); \
+            BinaryLog::write(binlogSite, ##__VA_ARGS__);                       \
+        }                                                                      \
+    } while (0)
+
+#define BINLOG_TRACE(format, ...) BINLOG_IF_ENABLED(Logger::TRACE, format, ##__VA_ARGS__)
+#define BINLOG_DEBUG(format, ...) BINLOG_IF_ENABLED(Logger::DEBUG, format, ##__VA_ARGS__)
+#define BINLOG_INFO(format, ...) BINLOG_IF_ENABLED(Logger::INFO, format, ##__VA_ARGS__)
+#define BINLOG_WARN(format, ...) BINLOG_IF_ENABLED(Logger::WARN, format, ##__VA_ARGS__)
+#define BINLOG_ERROR(format, ...) BINLOG_IF_ENABLED(Logger::ERROR, format, ##__VA_ARGS__)
@@ -0,0 +1,208 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * 连接的输入/输出缓冲区 一块连续内存加读写下标
+ * +-------------------+------------------+------------------+
+ * | prependable bytes |  readable bytes  |  writable bytes  |
+ * |                   |     (CONTENT)    |                  |
+ * +-------------------+------------------+------------------+
+ * 0      <=      readerIndex   <=   writerIndex    <=     size
+ *
+ * 1. 开头预留kCheapPrepend字节 消息写完之后可以在前面prepend长度头 不需要挪动消息
+ * 2. readFd用一次readv同时读入可写空间和栈上64KB的临时区 连接的缓冲区不需要预先分配很大
+ *    一次系统调用就能读空socket 多出来的部分再append进来
+ * 3. 空间不够时如果前面已经读走的部分加上可写空间放得下 把数据挪到前面 不重新分配
+ * 4. 整数按网络字节序读写 findCRLF在x86上用SSE2一次比较16字节
+ **/
+class Buffer
+{
+public:
+    static const size_t kCheapPrepend = 8;
+    static const size_t kInitialSize = 1024;
+
+    explicit Buffer(size_t initialSize = kInitialSize)
+        : buffer_(kCheapPrepend + initialSize), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend) {}
+
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
+    size_t readableBytes() const { return writerIndex_ - readerIndex_; }
+    size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+    size_t prependableBytes() const { return readerIndex_; }
+
+    // 可读数据的起始地址
+    const char *peek() const { return begin() + readerIndex_; }
+
+    // 在可读数据中查找"\r\n" 返回指向'\r'的指针 没有时返回nullptr
+    const char *findCRLF() const { return findCRLF(peek()); }
+    // 从start(必须在可读数据中)开始查找
+    const char *findCRLF(const char *start) const;
+    // 查找'\n' 没有时返回nullptr
+    const char *findEOL() const { return findEOL(peek()); }
+    const char *findEOL(const char *start) const
+    {
+        const void *eol = ::memchr(start, '\n', beginWrite() - start);
+        return static_cast<const char *>(eol);
+    }
+
+    // 读走len字节
+    void retrieve(size_t len)
+    {
+        if (len < readableBytes())
+        {
+            readerIndex_ += len;
+        }
+        else
+        {
+            retrieveAll();
+        }
+    }
+    // 读走到end(不含)为止的数据
+    void retrieveUntil(const char *end) { retrieve(end - peek()); }
+    void retrieveInt64() { retrieve(sizeof(int64_t)); }
+    void retrieveInt32() { retrieve(sizeof(int32_t)); }
+    void retrieveInt16() { retrieve(sizeof(int16_t)); }
+    void retrieveInt8() { retrieve(sizeof(int8_t)); }
+    void retrieveAll()
+    {
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+    }
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+    std::string retrieveAsString(size_t len)
+    {
+        std::string result(peek(), len);
+        retrieve(len);
+        return result;
+    }
+
+    void append(const char *data, size_t len)
+    {
+        ensureWritableBytes(len);
+        std::copy(data, data + len, beginWrite());
+        writerIndex_ += len;
+    }
+    void append(const void *data, size_t len) { append(static_cast<const char *>(data), len); }
+    void append(const std::string &str) { append(str.data(), str.size()); }
+
+    // 保证至少有len字节的可写空间
+    void ensureWritableBytes(size_t len)
+    {
+        if (writableBytes() < len)
+        {
+            makeSpace(len);
+        }
+    }
+
+    char *beginWrite() { return begin() + writerIndex_; }
+    const char *beginWrite() const { return begin() + writerIndex_; }
+    void hasWritten(size_t len) { writerIndex_ += len; }
+    void unwrite(size_t len) { writerIndex_ -= len; }
+
+    // 以网络字节序追加整数
+    void appendInt64(int64_t x) { appendBigEndian(htobe64(static_cast<uint64_t>(x))); }
+    void appendInt32(int32_t x) { appendBigEndian(htobe32(static_cast<uint32_t>(x))); }
+    void appendInt16(int16_t x) { appendBigEndian(htobe16(static_cast<uint16_t>(x))); }
+    void appendInt8(int8_t x) { append(&x, sizeof(x)); }
+
+    // 读出网络字节序的整数 要求readableBytes()足够
+    int64_t peekInt64() const { return static_cast<int64_t>(be64toh(peekRaw<uint64_t>())); }
+    int32_t peekInt32() const { return static_cast<int32_t>(be32toh(peekRaw<uint32_t>())); }
+    int16_t peekInt16() const { return static_cast<int16_t>(be16toh(peekRaw<uint16_t>())); }
+    int8_t peekInt8() const { return static_cast<int8_t>(*peek()); }
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieveInt64();
+        return result;
+    }
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieveInt32();
+        return result;
+    }
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieveInt16();
+        return result;
+    }
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieveInt8();
+        return result;
+    }
+
+    // 在可读数据前面插入数据 要求prependableBytes()足够 比如消息写完后补上长度头
+    void prepend(const void *data, size_t len)
+    {
+        readerIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+    void prependInt64(int64_t x)
+    {
+        uint64_t be = htobe64(static_cast<uint64_t>(x));
+        prepend(&be, sizeof(be));
+    }
+    void prependInt32(int32_t x)
+    {
+        uint32_t be = htobe32(static_cast<uint32_t>(x));
+        prepend(&be, sizeof(be));
+    }
+    void prependInt16(int16_t x)
+    {
+        uint16_t be = htobe16(static_cast<uint16_t>(x));
+        prepend(&be, sizeof(be));
+    }
+    void prependInt8(int8_t x) { prepend(&x, sizeof(x)); }
+
+    // 释放多余的容量 只保留可读数据加reserve字节
+    void shrink(size_t reserve)
+    {
+        Buffer other(readableBytes() + reserve);
+        other.append(peek(), readableBytes());
+        swap(other);
+    }
+    size_t internalCapacity() const { return buffer_.capacity(); }
+
+    /**
+     * 从fd读数据 一次readv读入可写空间和栈上的64KB临时区
+     * 返回readv的结果 出错时errno保存在savedErrno中
+     */
+    ssize_t readFd(int fd, int *savedErrno);
+
+private:
+    char *begin() { return buffer_.data(); }
+    const char *begin() const { return buffer_.data(); }
+
+    template <typename T>
+    T peekRaw() const
+    {
+        T x;
+        ::memcpy(&x, peek(), sizeof(x)); // 不要求对齐 编译成一次load
+        return x;
+    }
+    template <typename T>
+    void appendBigEndian(T be) { append(&be, sizeof(be)); }
+
+    // 腾出len字节的可写空间 能挪动时不重新分配
+    void makeSpace(size_t len);
+
+    std::vector<char> buffer_;
+    size_t readerIndex_;
+    size_t writerIndex_;
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+#include <memory>
+
+#include <Timestamp.hpp>
+
+class Buffer;
+class TcpConnection;
+
+// 连接由shared_ptr管理 回调中可以持有它 连接在最后一个持有者释放后才析构
+using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
+
+// 用户回调 TcpServer为每个连接复制一份 所以用可拷贝的std::function
+using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
+using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
+using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
+using HalfCloseCallback = std::function<void(const TcpConnectionPtr &)>;
+// 输出队列的字节数越过高/低水位时调用 第二个参数为当前输出队列的字节数
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+using LowWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
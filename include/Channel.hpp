@@ -1,6 +1,7 @@
 #pragma once
-#include <functional>
+#include <memory>
 
+#include <InlineFunction.hpp>
 #include "Timestamp.hpp"
 
 class EventLoop;
@@ -8,12 +9,25 @@ class EventLoop;
 /**
  * 理清楚 EventLoop、Channel、Poller之间的关系  Reactor模型上对应多路事件分发器
  * Channel理解为通道 封装了sockfd和其感兴趣的event 如EPOLLIN、EPOLLOUT事件 还绑定了poller返回的具体事件
+ *
+ * 触发模式:
+ * 默认水平触发 fd上还有数据没读完(或者还能写)时 每次poll都会再通知
+ * setEdgeTriggered(true)之后为边沿触发 只在状态变化时通知一次 回调必须遵守以下约定:
+ *   读回调循环read直到返回EAGAIN(或者读到0/出错) 否则剩下的数据不会再有通知
+ *   写回调循环write直到数据写完或者返回EAGAIN 返回EAGAIN后等待下一次可写通知
+ * 换来的是繁忙的长连接上不会因为一次没读完而被反复唤醒
+ *
+ * 关注事件的变更:
+ * loop运行期间在loop线程中调用enableXxx/disableXxx不会立即epoll_ctl 只是把channel记为待更新
+ * EventLoop在下一次poll之前按最终的events统一提交一次 与上次提交的相同则不产生系统调用
+ * 比如回调中先enableWriting又disableWriting 最终什么都不做
  **/
 class Channel
 {
 public:
-    using EventCallback = std::function<void()>;
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    // 回调只在设置时移动一次 之后原地调用 不要求可拷贝
+    using EventCallback = InlineFunction<void()>;
+    using ReadEventCallback = InlineFunction<void(Timestamp)>;
 
     Channel(EventLoop *loop, int fd);
     ~Channel() = default;
@@ -26,14 +40,28 @@ public:
     void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
     void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
     void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+    // 对端关闭了写端(EPOLLRDHUP)时在读回调之后调用 未设置时由读回调read到0再处理
+    // 水平触发下半关闭状态会一直被通知 回调中应当disableReading或者关闭连接
+    void setHalfCloseCallback(EventCallback cb) { halfCloseCallback_ = std::move(cb); }
 
     // 防止当channel被手动remove时，channel还在执行回调操作
     void tie(const std::shared_ptr<void> &);
 
     int fd() const { return fd_; }                  // 获取文件描述符
-    int events() const { return events_; }          // 获取感兴趣的事件
+    int events() const;                             // 获取注册到epoll的事件(含触发模式标志)
+    int interestEvents() const { return events_; }  // 获取感兴趣的事件(不含触发模式标志)
+    int revents() const { return revents_; }        // 获取实际发生的事件
     void set_revents(int revt) { revents_ = revt; } // 设置实际发生的事件
 
+    // 边沿触发(EPOLLET) 回调需要遵守上面的约定
+    void setEdgeTriggered(bool on);
+    bool isEdgeTriggered() const { return mode_ & kEdgeTriggered; }
+    // EPOLLEXCLUSIVE 多个线程各自的epoll监听同一个listenfd时 一个新连接只唤醒其中一个 避免惊群
+    // 必须在enableReading之前设置 只对读事件有意义(EPOLLPRI/EPOLLRDHUP会被去掉)
+    // 内核不允许对EPOLLEXCLUSIVE的fd做EPOLL_CTL_MOD Poller会改为先删除再添加
+    void setExclusive(bool on);
+    bool isExclusive() const { return mode_ & kExclusive; }
+
     // 设置fd相应的事件状态 相当于epoll_ctl add delete
     void enableReading()
     {
@@ -55,6 +83,11 @@ public:
         events_ &= ~kWriteEvent;
         update();
     }
+    void disableAll()
+    {
+        events_ = kNoneEvent;
+        update();
+    }
 
     // 返回fd当前的事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
@@ -67,6 +100,14 @@ public:
     EventLoop *ownerLoop() { return loop_; } // 获取该channel所属的EventLoop
     void remove();                           // 从poller中删除该channel
 
+    // 是否有还未提交给poller的关注事件变更 由EventLoop维护
+    // pendingIndex为channel在待更新列表中的下标 -1表示不在列表中 删除channel时据此O(1)摘除
+    bool updatePending() const { return pendingIndex_ >= 0; }
+    int pendingIndex() const { return pendingIndex_; }
+    void setPendingIndex(int index) { pendingIndex_ = index; }
+    // 把当前的events提交给poller 与上次提交的相同时什么都不做
+    void commitUpdate();
+
 private:
     void update();                                    // 更新channel所感兴趣的事件
     void handleEventWithGuard(Timestamp receiveTime); // 该函数用于处理在指定时间接收到的事件，并执行必要的防护逻辑
@@ -74,12 +115,17 @@ private:
     static const int kNoneEvent;  // 无事件
     static const int kReadEvent;  // 可读事件
     static const int kWriteEvent; // 可写事件
+    static const int kEdgeTriggered; // 边沿触发标志
+    static const int kExclusive;     // 独占唤醒标志
 
     EventLoop *loop_; // 事件循环
     const int fd_;    // fd, Poller监听的对象
     int events_;      // 注册fd感兴趣的事件（如读/写/异常事件）
+    int mode_;        // 触发模式标志(EPOLLET/EPOLLEXCLUSIVE) 与events_分开存放 不影响isNoneEvent
     int revents_;     // poller填充返回的具体发生的事件掩码（运行时状态反馈）
     int index_;       // 内部状态索引，用于标识该监控项在事件循环中的位置或状态机状态
+    int committedEvents_; // 最近一次提交给poller的events() 用于跳过没有变化的更新
+    int pendingIndex_;    // 在EventLoop的待更新列表中的下标 -1表示不在列表中
 
     std::weak_ptr<void> tie_; // 弱引用指针，用于观察关联对象的生命周期状态
     bool tied_;               // 绑定状态标志，指示当前对象是否已绑定到目标资源
@@ -89,4 +135,5 @@ private:
     EventCallback writeCallback_;
     EventCallback closeCallback_;
     EventCallback errorCallback_;
-}
\ No newline at end of file
+    EventCallback halfCloseCallback_;
+};
@@ -5,6 +5,8 @@
 namespace CurrentThread
 {
     extern thread_local int t_cachedTid;
+    extern thread_local char t_tidString[32]; // 日志中的tid 提前格式化好 "%5d "
+    extern thread_local int t_tidStringLength;
     void cacheTid();
     inline int tid() // 内联函数只在当前文件中起作用
     {
@@ -16,4 +18,7 @@ namespace CurrentThread
         }
         return t_cachedTid;
     }
+    // 调用前先调用tid() 保证已经缓存
+    inline const char *tidString() { return t_tidString; }
+    inline int tidStringLength() { return t_tidStringLength; }
 } // namespace CurrentThread
\ No newline at end of file
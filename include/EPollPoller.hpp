@@ -35,4 +35,4 @@ private:
 
     int epollfd_;      // epoll_create返回的fd保存在epollfd_中
     EventList events_; // 用于存放epoll_wait返回的所有发生的事件的文件描述符事件集
-}
\ No newline at end of file
+};
@@ -1,7 +1,21 @@
 #pragma once
 #include <functional>
 #include <atomic>
-#include <mutex>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/types.h>
+
+#include <CurrentThread.hpp>
+#include <InlineFunction.hpp>
+#include <MpscQueue.hpp>
+#include <TimerId.hpp>
+#include <TimingWheel.hpp>
+#include <Timestamp.hpp>
+
+class Channel;
+class Poller;
+class TimerQueue;
 
 // 事件循环类 主要包含两大模块 Channel Poller
 // Channel封装了sockfd和感兴趣的事件以及发生的事件
@@ -9,10 +23,11 @@
 class EventLoop
 {
 public:
-    using Functor = std::function<void()>;
+    // 只能移动的回调类型 捕获shared_ptr加几个值的lambda不会分配内存 见InlineFunction.hpp
+    using Functor = InlineFunction<void()>;
 
-    EventLoop() = default;
-    ~EventLoop() = default;
+    EventLoop();
+    ~EventLoop();
 
     // 开启事件循环
     void loop();
@@ -26,46 +41,91 @@ public:
     // 把上层注册的回调函数cb放入队列中，唤醒loop所在的线程，执行cb
     void queueInLoop(Functor cb);
 
-    // 通过eventfd唤醒loop所在的线程
+    // 通过eventfd唤醒loop所在的线程 每次调用都会write一次eventfd
     void wakeup();
 
     // EentLoop的方法 => Poller的方法
     void updateChannel(Channel *channel);
+    // loop运行中且在loop线程调用时 把channel加入待更新列表并返回true 在下一次poll之前统一提交
+    // 否则返回false 由调用者立即提交
+    bool queueChannelUpdate(Channel *channel);
     void removeChannel(Channel *channel);
     bool hasChannel(Channel *channel);
+    // 当前loop上注册的channel个数 可以跨线程调用 结果是近似值
+    int numChannels() const;
 
     // 判断EventLoop对象是否在自己的线程里
     // threadId_为EentLoop创建时的线程id，CurrentThread::tid()为当前线程id
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
     /**
-     * 定时任务相关函数
+     * 定时任务相关函数 返回的TimerId可用于cancel
+     * 定时器基于CLOCK_MONOTONIC 修改系统时间不会使其提前触发或者延后
      */
     // 在某个时间点执行回调
-    void runAt(Timestamp timestamp, Functor &&cb)
-    {
-        timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
-    }
+    TimerId runAt(Timestamp timestamp, Functor &&cb);
     // 多少秒后执行回调
-    void runAfter(double waitTime, Functor &&cb)
-    {
-        Timestamp timestamp(addTIme(Timestamp::now(), waitTime));
-        timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
-    }
+    TimerId runAfter(double waitTime, Functor &&cb);
     // 每隔多少秒执行一次回调
-    void runEvery(double interval, Functor &&cb)
-    {
-        Timestamp timestamp(addTIme(Timestamp::now(), interval));
-        timerQueue_->addTimer(std::move(cb), timestamp, interval);
-    }
+    TimerId runEvery(double interval, Functor &&cb);
+    // 取消定时器
+    void cancel(TimerId timerId);
+
+    /**
+     * 粗粒度超时(连接空闲/keepalive)相关函数 基于时间轮 精度为一个tick
+     * entry由调用者内嵌持有 刷新超时直接调用entry->touch() 无需经过EventLoop
+     * 只能在loop所在线程中调用
+     */
+    // timeout秒内没有touch则执行entry的回调
+    void addIdleTimeout(TimingWheel::Entry *entry, double timeout);
+    // 移除超时项
+    void removeIdleTimeout(TimingWheel::Entry *entry);
+
+    /**
+     * 忙轮询 用于对延迟敏感的loop 默认关闭
+     * 有事件发生后 loop以0超时反复poll(自旋) 不进入内核睡眠 省掉睡眠/唤醒和调度的延迟
+     * 距离上一次有事件超过spinBudgetUs微秒 或者连续maxIdleSpins次poll都没有事件时 回到阻塞的poll
+     * 下一次被事件唤醒后重新开始自旋 spinBudgetUs为0表示关闭
+     * socketBusyPollUs>0时 新建立的连接会设置SO_BUSY_POLL(见setSocketBusyPoll)
+     * 让内核在recv时直接轮询网卡队列 需要CAP_NET_ADMIN才能设置超过sysctl net.core.busy_read的值
+     * 在loop开始之前或者loop所在线程中调用
+     */
+    void setBusyPoll(int64_t spinBudgetUs, int maxIdleSpins, int socketBusyPollUs = 0);
+    bool busyPollEnabled() const { return spinBudgetUs_ > 0; }
+    int socketBusyPollUs() const { return socketBusyPollUs_; }
+    // 对sockfd设置SO_BUSY_POLL 失败时记录日志并返回false
+    static bool setSocketBusyPoll(int sockfd, int usec);
+
+    // 忙轮询统计 可以跨线程读取 自旋次数/阻塞次数用于权衡CPU消耗和尾延迟
+    uint64_t spinPolls() const { return spinPolls_.load(std::memory_order_relaxed); }         // 0超时的poll次数
+    uint64_t spinHits() const { return spinHits_.load(std::memory_order_relaxed); }           // 其中返回了事件的次数
+    uint64_t blockingPolls() const { return blockingPolls_.load(std::memory_order_relaxed); } // 阻塞的poll次数
+
+    /**
+     * 挂在loop上的用户对象 比如每个loop一份的缓存(见StaticFileCache)
+     * 在~EventLoop开头释放 此时poller还在 对象的析构函数可以remove自己的channel
+     * 只能在loop所在线程中访问
+     */
+    void setContext(std::shared_ptr<void> context) { context_ = std::move(context); }
+    const std::shared_ptr<void> &getContext() const { return context_; }
 
 private:
     void handleRead(); // 给eventfd返回的文件描述符wakeupFd_绑定的事件回调
     // 当wakeup()时 即有事件发生时 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
     void doPendingFunctors(); // 执行上层回调函数
+    void flushChannelUpdates(); // 把本轮积累的channel关注事件变更提交给poller
+    int nextPollTimeout();       // 计算本轮poll的超时时间 忙轮询自旋时为0
+    void recordPoll(int timeoutMs, bool gotEvents); // 更新忙轮询状态和统计
 
     using ChannelList = std::vector<Channel *>;
 
+    // 任务队列的节点 回调和链表指针在同一块内存中 每个任务只分配一次
+    struct PendingFunctor : public MpscQueue::Node
+    {
+        explicit PendingFunctor(Functor &&cb) : functor(std::move(cb)) {}
+        Functor functor;
+    };
+
     std::atomic_bool looping_; // 原子操作 事件循环是否启动 底层通过CAS实现
     std::atomic_bool quit_;    // 标识退出loop循环
 
@@ -75,12 +135,28 @@ private:
 
     std::unique_ptr<Poller> poller_;         // IO多路复用器
     std::unique_ptr<TimerQueue> timerQueue_; // 定时器
+    TimingWheel timingWheel_;                // 粗粒度超时时间轮 由pollReturnTime_推进
     int wakeupFd_;                           // eventfd文件描述符 用于唤醒loop所在的线程
     std::unique_ptr<Channel> wakeupChannel_; // 封装wakeupFd_的channel
 
-    ChanelList activeChannels_; // poller返回的活跃事件列表
+    ChannelList activeChannels_; // poller返回的活跃事件列表
+    ChannelList pendingUpdates_; // 关注事件有变更 等待在下一次poll之前提交的channel
 
     std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有回调操作
-    std::mutex mutex_;                        // 互斥锁 用于保护上面vector容器的线程安全
+    MpscQueue pendingFunctors_;               // 存储loop需要执行的所有回调操作 无锁队列
+    std::atomic_bool wakeupPending_;          // 已经write过eventfd且loop还没有开始处理任务队列
+
+    // 忙轮询配置和状态 只在loop线程中访问
+    int64_t spinBudgetUs_;   // 每次有事件后最多自旋的时间(微秒) 0表示关闭
+    int maxIdleSpins_;       // 连续多少次自旋没有事件后回到阻塞
+    int socketBusyPollUs_;   // 新连接的SO_BUSY_POLL 0表示不设置
+    bool spinning_;          // 当前是否处于自旋阶段
+    int idleSpins_;          // 当前连续没有事件的自旋次数
+    int64_t lastActiveUs_;   // 最近一次poll到事件的单调时间(微秒)
+    // 统计 见spinPolls()/spinHits()/blockingPolls()
+    std::atomic<uint64_t> spinPolls_;
+    std::atomic<uint64_t> spinHits_;
+    std::atomic<uint64_t> blockingPolls_;
+
+    std::shared_ptr<void> context_; // 见setContext
 };
\ No newline at end of file
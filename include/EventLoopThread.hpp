@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <Thread.hpp>
+
+class EventLoop;
+
+// one loop per thread: 在新线程中创建EventLoop并运行loop()
+class EventLoopThread
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(),
+                    const std::string &name = std::string());
+    ~EventLoopThread();
+
+    EventLoopThread(const EventLoopThread &) = delete;
+    EventLoopThread &operator=(const EventLoopThread &) = delete;
+
+    // 启动线程并等待 返回时loop已经进入事件循环
+    EventLoop *startLoop();
+
+    // startLoop拆成两步 线程池先启动所有线程再逐个等待 各线程的启动可以并行
+    void start();
+    EventLoop *waitForLoop();
+
+private:
+    void threadFunc();
+
+    EventLoop *loop_; // 新线程中栈上的EventLoop 进入事件循环后才会被设置
+    bool exiting_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    ThreadInitCallback callback_; // loop创建后、进入事件循环前在新线程中调用
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+class EventLoop;
+class EventLoopThread;
+
+/**
+ * 多Reactor线程池 baseLoop_为mainloop(负责accept) 池中每个线程运行一个subloop
+ * 新连接通过getLoopForPeer按分配策略交给某个subloop处理
+ * 线程数为0时所有连接都由baseLoop_处理(单Reactor)
+ **/
+class EventLoopThreadPool
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    // 连接分配策略
+    enum DispatchPolicy
+    {
+        kRoundRobin,     // 轮询
+        kLeastChannels,  // 选择注册channel最少的loop
+        kConsistentHash, // 按对端ip做一致性哈希 同一客户端总是落在同一个loop上
+    };
+
+    EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
+    ~EventLoopThreadPool();
+
+    EventLoopThreadPool(const EventLoopThreadPool &) = delete;
+    EventLoopThreadPool &operator=(const EventLoopThreadPool &) = delete;
+
+    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    void setDispatchPolicy(DispatchPolicy policy) { policy_ = policy; }
+
+    // 启动所有线程 返回时所有subloop都已经进入事件循环
+    void start(const ThreadInitCallback &cb = ThreadInitCallback());
+
+    // 轮询取下一个subloop
+    EventLoop *getNextLoop();
+    // 按分配策略为对端地址为peerAddr的新连接选择subloop peerAddr可以为空(退化为轮询)
+    EventLoop *getLoopForPeer(const struct sockaddr *peerAddr);
+    // 按哈希值选择subloop 同一个hash在线程数不变时总是得到同一个loop
+    EventLoop *getLoopForHash(uint64_t hash);
+
+    std::vector<EventLoop *> getAllLoops();
+
+    bool started() const { return started_; }
+    const std::string &name() const { return name_; }
+
+private:
+    EventLoop *getLeastLoadedLoop();
+
+    EventLoop *baseLoop_; // 用户创建的mainloop
+    std::string name_;    // 线程池名称 线程名为name_+序号
+    bool started_;
+    int numThreads_;
+    int next_;              // 轮询的下标
+    DispatchPolicy policy_; // 连接分配策略
+    std::vector<std::unique_ptr<EventLoopThread>> threads_;
+    std::vector<EventLoop *> loops_; // 所有subloop
+};
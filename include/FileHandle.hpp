@@ -0,0 +1,39 @@
+#pragma once
+#include <memory>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+class FileHandle;
+using FileHandlePtr = std::shared_ptr<FileHandle>;
+
+/**
+ * 持有一个用于发送的文件fd 析构时关闭
+ * TcpConnection::sendFile通过shared_ptr持有它直到数据发送完 调用者可以立即释放自己的引用
+ * 构造时fstat一次并保存结果: 普通文件用sendfile发送 管道/socket/设备等用splice经过管道发送
+ **/
+class FileHandle
+{
+public:
+    // 接管fd fstat失败时按非普通文件处理
+    explicit FileHandle(int fd);
+    ~FileHandle();
+
+    FileHandle(const FileHandle &) = delete;
+    FileHandle &operator=(const FileHandle &) = delete;
+
+    // 只读打开path 失败返回nullptr errno保持不变
+    static FileHandlePtr open(const char *path);
+    // dup一份fd(close-on-exec) 调用者仍然持有原来的fd 失败返回nullptr
+    static FileHandlePtr dup(int fd);
+
+    int fd() const { return fd_; }
+    bool isRegular() const { return S_ISREG(stat_.st_mode); }
+    // 普通文件为构造时的大小 其他为0
+    off_t size() const { return isRegular() ? stat_.st_size : 0; }
+    // 构造时的fstat结果 失败时全部为0
+    const struct stat &stat() const { return stat_; }
+
+private:
+    const int fd_;
+    struct stat stat_;
+};
@@ -1,23 +1,39 @@
 #pragma once
 #include <string>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <stdio.h>
 
+/**
+ * 日志文件 不经过stdio 直接用pwritev写文件
+ * 1. append的小块数据先拷贝到64KB的缓冲区中 攒满或者flush时写出 与原来的fwrite相同
+ * 2. appendv把调用者的多段内存(比如日志缓冲区中的记录)一次pwritev写入 不再拷贝
+ * 3. 打开文件时用fallocate预分配preallocate字节(不改变文件大小) 写入时不用再分配磁盘块
+ *    关闭时把文件截断到实际写入的位置 释放没用完的预分配空间
+ **/
 class FileUtil
 {
 public:
-    FileUtil(std::string &file_name);
+    explicit FileUtil(std::string &file_name, off_t preallocate = 0);
     ~FileUtil();
     // 向文件写入数据
     void append(const char *data, size_t len);
+    // 把多段数据按顺序写入文件 count不限 写入前先写出缓冲区中的数据
+    void appendv(const struct iovec *iov, int count);
     // 刷新文件缓冲区,将缓冲区中的数据立即写入文件
     void flush();
     // 获取已写入的字节数,返回已写入文件的总字节数
     off_t writtenBytes() const { return writtenBytes_; }
+    // 文件的逻辑长度(包括还在缓冲区中的数据) 即下一次写入的数据在文件中的位置
+    off_t size() const { return offset_ + static_cast<off_t>(used_); }
 
 private:
-    size_t write(const char *data, size_t len);
-    FILE *file_;             // 文件指针，用于操作文件
-    char buffer_[64 * 1024]; // 文件操作的缓冲区，大小为64KB，用于提高写入效率
+    // 从offset_开始写入全部数据 处理部分写入和EINTR 出错时打印错误并放弃剩余部分 返回写入的字节数
+    size_t writeFully(struct iovec *iov, int count);
+
+    int fd_;                 // 文件描述符
+    off_t offset_;           // 下一次写入的文件位置
+    size_t used_;            // buffer_中待写出的字节数
+    char buffer_[64 * 1024]; // 小块数据的缓冲区，大小为64KB，用于减少系统调用
     off_t writtenBytes_;     // 记录已写入文件的总字节数，off_t类型用于大文件支持
-};
\ No newline at end of file
+};
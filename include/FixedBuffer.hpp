@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <cstring>
 
 class AsynLogging;
 constexpr int kSmallBufferSize = 4000;
@@ -38,13 +39,13 @@ public:
     // 重置当前指针，回到缓冲区的起始位置
     void reset()
     {
-        cur = data_;
+        cur_ = data_;
         size_ = 0;
     }
     // 清空缓冲区中的数据
     void bzero()
     {
-        ::bezero(data_, sizeof(data_));
+        ::bzero(data_, sizeof(data_));
     }
     // 将缓冲区中的数据转换成std：：string并返回
     std::string toString() const
@@ -54,6 +55,46 @@ public:
 
 private:
     char data_[buffer_size]; // 定义固定大小的缓冲区
-    char *cur;               // 当前指针，指向缓冲区下一个可写入的位置
+    char *cur_;              // 当前指针，指向缓冲区下一个可写入的位置
     int size_;               // 缓冲区的大小
+};
+
+// 不持有内存的缓冲区 接口与FixedBuffer相同
+// LogStream用它格式化到自己的存储中 或者直接格式化到日志后端预留的内存中
+class LogBuffer
+{
+public:
+    LogBuffer(char *data, size_t capacity)
+        : data_(data), cur_(data), end_(data + capacity) {}
+    // 将指定长度的数据追加到缓冲区
+    void append(const char *buf, size_t len)
+    {
+        if (avail() > len)
+        {
+            memcpy(cur_, buf, len);
+            add(len);
+        }
+    }
+    // 返回缓冲区的起始地址
+    const char *data() const { return data_; }
+    // 返回缓冲区中当前有效数据的长度
+    int length() const { return static_cast<int>(cur_ - data_); }
+    // 返回当前指针的位置
+    char *current() { return cur_; }
+    // 返回缓冲区中剩余可用空间的大小
+    size_t avail() const { return static_cast<size_t>(end_ - cur_); }
+    // 更新当前指针
+    void add(size_t len) { cur_ += len; }
+    // 重置当前指针，回到缓冲区的起始位置
+    void reset() { cur_ = data_; }
+    // 将缓冲区中的数据转换成std：：string并返回
+    std::string toString() const
+    {
+        return std::string(data_, length());
+    }
+
+private:
+    char *data_; // 缓冲区起始地址
+    char *cur_;  // 当前指针，指向缓冲区下一个可写入的位置
+    char *end_;  // 缓冲区结束地址
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+
+// 封装socket地址 支持IPv4和IPv6
+class InetAddress
+{
+public:
+    // 监听地址 ip为空时监听所有地址 ipv6为true时使用IPv6(同时接受IPv4映射地址)
+    explicit InetAddress(uint16_t port = 0, const std::string &ip = std::string(), bool ipv6 = false);
+    explicit InetAddress(const struct sockaddr_in &addr) : addr_(addr) {}
+    explicit InetAddress(const struct sockaddr_in6 &addr) : addr6_(addr) {}
+
+    sa_family_t family() const { return addr_.sin_family; }
+    std::string toIp() const;
+    std::string toIpPort() const; // IPv4为"1.2.3.4:80" IPv6为"[::1]:80"
+    uint16_t port() const { return ntohs(addr_.sin_port); }
+
+    const struct sockaddr *getSockAddr() const { return reinterpret_cast<const struct sockaddr *>(&addr6_); }
+    struct sockaddr *getSockAddr() { return reinterpret_cast<struct sockaddr *>(&addr6_); }
+    // 按地址族得到sockaddr的长度 用于bind/connect
+    socklen_t sockAddrLength() const
+    {
+        return family() == AF_INET6 ? sizeof(addr6_) : sizeof(addr_);
+    }
+
+    // 已连接socket的本端/对端地址
+    static InetAddress localAddress(int sockfd);
+    static InetAddress peerAddress(int sockfd);
+
+private:
+    // sin_family和sin_port在两种结构中位置相同
+    union
+    {
+        struct sockaddr_in addr_;
+        struct sockaddr_in6 addr6_;
+    };
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 只能移动的回调对象 用来代替std::function 作为EventLoop::Functor和Channel回调的类型
+ * 1. 内部有kInlineSize字节的存储 捕获一个shared_ptr再加几个值的lambda可以直接放下 不分配内存
+ *    libstdc++的std::function只有16字节的内部存储 这类lambda每次构造都要malloc
+ * 2. 不要求可拷贝 可以捕获unique_ptr等只能移动的对象 移动时也不会分配内存
+ * 3. 放不下(或者移动构造可能抛异常)的可调用对象退化为堆上分配
+ *    每次退化都会计入heapFallbacks() 便于在线上统计是否有热路径上的回调超出了内部存储
+ *    定义宏INLINE_FUNCTION_NO_HEAP后 退化会变成编译错误 用于在编译期找出这些回调
+ **/
+
+// 退化为堆分配的次数(所有InlineFunction实例共享)
+inline std::atomic<long> &inlineFunctionHeapFallbackCounter()
+{
+    static std::atomic<long> counter(0);
+    return counter;
+}
+
+template <typename Signature, size_t Capacity = 56>
+class InlineFunction;
+
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+public:
+    static constexpr size_t kInlineSize = Capacity;
+
+    // 可调用对象F能否放在内部存储中
+    template <typename F>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(F) <= Capacity &&
+               alignof(F) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible<F>::value;
+    }
+
+    // 所有实例累计退化为堆分配的次数
+    static long heapFallbacks()
+    {
+        return inlineFunctionHeapFallbackCounter().load(std::memory_order_relaxed);
+    }
+
+    InlineFunction() noexcept : ops_(nullptr) {}
+    InlineFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename Fn = typename std::decay<F>::type,
+              typename = typename std::enable_if<
+                  !std::is_same<Fn, InlineFunction>::value &&
+                  std::is_invocable_r<R, Fn &, Args...>::value>::type>
+    InlineFunction(F &&f) : ops_(nullptr)
+    {
+        assign<Fn>(std::forward<F>(f));
+    }
+
+    InlineFunction(InlineFunction &&other) noexcept : ops_(other.ops_)
+    {
+        if (ops_)
+        {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineFunction &operator=(InlineFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_)
+            {
+                other.ops_->move(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction &) = delete;
+    InlineFunction &operator=(const InlineFunction &) = delete;
+
+    ~InlineFunction() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+private:
+    // 手写的虚函数表 每种可调用对象类型一份 对象本身只多一个指针
+    struct Ops
+    {
+        R (*invoke)(void *storage, Args &&...args);
+        void (*move)(void *dst, void *src) noexcept; // 移动到dst并析构src
+        void (*destroy)(void *storage) noexcept;
+    };
+
+    // 可调用对象直接构造在storage_中
+    template <typename F>
+    struct InlineOps
+    {
+        static R invoke(void *storage, Args &&...args)
+        {
+            return call(*static_cast<F *>(storage), std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src) noexcept
+        {
+            F *from = static_cast<F *>(src);
+            ::new (dst) F(std::move(*from));
+            from->~F();
+        }
+        static void destroy(void *storage) noexcept
+        {
+            static_cast<F *>(storage)->~F();
+        }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    // storage_中只存放指向堆上对象的指针
+    template <typename F>
+    struct HeapOps
+    {
+        static F *&ptr(void *storage) { return *static_cast<F **>(storage); }
+        static R invoke(void *storage, Args &&...args)
+        {
+            return call(*ptr(storage), std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src) noexcept
+        {
+            ::new (dst) F *(ptr(src));
+        }
+        static void destroy(void *storage) noexcept { delete ptr(storage); }
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    // R为void时丢弃可调用对象的返回值 与std::function的行为一致
+    template <typename F>
+    static R call(F &f, Args &&...args)
+    {
+        if constexpr (std::is_void<R>::value)
+        {
+            std::invoke(f, std::forward<Args>(args)...);
+        }
+        else
+        {
+            return std::invoke(f, std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename Fn, typename F>
+    void assign(F &&f)
+    {
+        if constexpr (std::is_pointer<Fn>::value ||
+                      std::is_member_pointer<Fn>::value)
+        {
+            if (f == nullptr)
+            {
+                return;
+            }
+        }
+        if constexpr (fitsInline<Fn>())
+        {
+            ::new (static_cast<void *>(storage_)) Fn(std::forward<F>(f));
+            ops_ = &InlineOps<Fn>::ops;
+        }
+        else
+        {
+#ifdef INLINE_FUNCTION_NO_HEAP
+            static_assert(fitsInline<Fn>(),
+                          "callable does not fit in InlineFunction storage "
+                          "and would be heap allocated");
+#endif
+            inlineFunctionHeapFallbackCounter().fetch_add(1, std::memory_order_relaxed);
+            ::new (static_cast<void *>(storage_)) Fn *(new Fn(std::forward<F>(f)));
+            ops_ = &HeapOps<Fn>::ops;
+        }
+    }
+
+    void reset() noexcept
+    {
+        if (ops_)
+        {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+    const Ops *ops_;
+};
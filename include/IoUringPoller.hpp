@@ -0,0 +1,104 @@
+#pragma once
+#include <Poller.hpp>
+#include <cstdint>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * 基于io_uring的Poller 与EPollPoller实现相同的poll/updateChannel/removeChannel接口
+ * 直接使用io_uring_setup/io_uring_enter系统调用 不依赖liburing
+ *
+ * 1. 关注事件的注册/修改/删除只是往提交队列(SQ)里写一个SQE 不产生系统调用
+ *    所有SQE在下一次poll()时随io_uring_enter一起提交 等待事件也是同一次io_uring_enter
+ *    连接频繁建立/断开时 每轮循环只有一次系统调用 而epoll每次变更都要一次epoll_ctl
+ * 2. 完成队列(CQ)中的事件在poll()返回前一次性批量收割
+ * 3. 水平触发的channel使用一次性POLL_ADD: 事件触发后在下一次poll()时按channel当时的events重新挂上
+ *    重新检查就绪状态 与epoll的水平触发语义一致 且只有一个SQE的开销
+ *    边沿触发的channel使用multishot POLL_ADD(IORING_POLL_ADD_MULTI) 挂上一次持续通知
+ *    multishot在fd还有未读数据时不会再次通知 正好就是边沿触发的语义
+ * 4. 每个fd有一个序号 编码在user_data中 fd被删除或复用后 迟到的完成事件按序号识别并丢弃
+ *
+ * 内核不支持io_uring(或被禁用、缺少IORING_FEAT_EXT_ARG)时valid()返回false
+ * Poller::newDefaultPoller据此回退到epoll
+ **/
+class IoUringPoller : public Poller
+{
+public:
+    IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    // io_uring是否初始化成功
+    bool valid() const { return ringFd_ >= 0; }
+
+    // 重写Poller基类的抽象方法
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+
+private:
+    static const unsigned kRingEntries = 1024; // SQ大小 CQ默认为其两倍
+
+    // 每个fd的状态 按fd下标存放
+    struct FdState
+    {
+        uint32_t sequence; // 当前注册的序号 user_data中的序号与之不同的完成事件都已失效
+        bool armed;        // 是否有一个未完成的POLL_ADD
+        bool rearm;        // 事件已触发 需要在下一次poll()时重新挂上
+        bool multishot;    // 当前的POLL_ADD是否为multishot
+        uint64_t batch;    // 最近一次加入活跃列表的收割批次 multishot同一批的多个事件合并为一个
+    };
+
+    bool setupRing();
+    void teardownRing();
+
+    FdState &stateOf(int fd);
+
+    // 获取一个空闲的SQE SQ满时先提交已有的SQE 直到内核取走足够的SQE为止 不会覆盖未提交的SQE
+    io_uring_sqe *getSqe();
+    // 提交SQ中的SQE 并等待至少waitNr个完成事件
+    int enter(unsigned toSubmit, unsigned waitNr, int timeoutMs);
+    unsigned pendingSqes() const;
+
+    void armPoll(Channel *channel);             // POLL_ADD
+    void cancelPoll(int fd, uint32_t sequence); // POLL_REMOVE
+    void rearmFiredChannels();
+
+    // 收割完成队列 填写活跃的连接
+    void reapCompletions(ChannelList *activeChannels);
+    void handleCompletion(const io_uring_cqe &cqe, ChannelList *activeChannels);
+    // 提交时CQ溢出(EBUSY) 把完成事件移到stashedCqes_ 腾出CQ 由下一次reapCompletions处理
+    void stashCompletions();
+
+    static uint64_t encode(int fd, uint32_t sequence)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | sequence;
+    }
+
+    int ringFd_;
+
+    // 提交队列
+    void *sqRing_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    unsigned sqTailLocal_; // 本地队尾 在io_uring_enter之前才发布给内核
+
+    // 完成队列
+    void *cqRing_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    io_uring_cqe *cqes_;
+
+    std::vector<FdState> fdStates_; // fd => 状态
+    std::vector<int> rearmFds_;     // 等待重新挂上POLL_ADD的fd
+    std::vector<io_uring_cqe> stashedCqes_; // 提前移出CQ还没有处理的完成事件
+    uint64_t batch_;                // 当前收割批次
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <LogIndex.hpp>
+#include <Thread.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * 滚动后的日志文件在后台线程中用zlib压缩成.gz 并按个数/总大小清理最旧的压缩文件
+ * 1. LogFile滚动时只把旧文件名交给add() 写日志的线程从不等待压缩
+ * 2. 后台线程以最低的CPU优先级(nice 19)和空闲I/O优先级运行 压缩完fsync .gz文件再删除原文件
+ * 3. 日志文件有时间索引(xxx.log.idx)时每个索引块压成一个独立的gzip member 索引转换成xxx.log.gz.idx
+ *    按索引可以只解压需要的块 见tools/LogQuery
+ * 4. stats()给出还没压缩完的文件个数和字节数 用于判断压缩是否跟不上写入速度
+ **/
+class LogCompressor
+{
+public:
+    struct Stats
+    {
+        size_t pendingFiles;       // 等待压缩的文件个数(含正在压缩的)
+        uint64_t pendingBytes;     // 等待压缩的字节数
+        uint64_t compressedFiles;  // 已经压缩的文件个数
+        uint64_t bytesIn;          // 压缩前的总字节数
+        uint64_t bytesOut;         // 压缩后的总字节数
+        uint64_t removedFiles;     // 因为超出保留限制删除的压缩文件个数
+    };
+
+    /**
+     * @param basename 日志文件基本名称 与LogFile相同 用于找到需要清理的basename.*.log.gz
+     * @param level zlib压缩等级 1最快 9最小
+     * @param keepFiles 最多保留的压缩文件个数 0表示不限
+     * @param keepBytes 压缩文件最多占用的字节数 0表示不限
+     */
+    LogCompressor(const std::string &basename, int level = 6,
+                  size_t keepFiles = 0, off_t keepBytes = 0);
+    // 压缩完所有已经加入的文件之后退出
+    ~LogCompressor();
+
+    LogCompressor(const LogCompressor &) = delete;
+    LogCompressor &operator=(const LogCompressor &) = delete;
+
+    // 加入一个已经写完的日志文件 不阻塞 空文件会被忽略
+    void add(const std::string &filename);
+
+    Stats stats() const;
+
+private:
+    void threadFunc();
+    // 把filename压缩成filename.gz 成功后删除原文件 返回压缩后的字节数 失败返回-1
+    off_t compress(const std::string &filename);
+    // 写出.gz的索引 entries的前count项已经换算成.gz中的位置
+    bool writeIndex(const std::string &target, const std::vector<LogIndex::Entry> &entries, size_t count);
+    // 按保留限制删除最旧的压缩文件(连同它的索引)
+    void enforceRetention();
+
+    const std::string basename_;
+    const int level_;
+    const size_t keepFiles_;
+    const off_t keepBytes_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::string> queue_; // 等待压缩的文件 由mutex_保护
+    bool running_;                  // 由mutex_保护
+    size_t pendingFiles_;           // 由mutex_保护
+    uint64_t pendingBytes_;         // 由mutex_保护
+
+    std::atomic<uint64_t> compressedFiles_;
+    std::atomic<uint64_t> bytesIn_;
+    std::atomic<uint64_t> bytesOut_;
+    std::atomic<uint64_t> removedFiles_;
+    Thread thread_;
+};
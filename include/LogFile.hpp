@@ -4,8 +4,12 @@
 #include <mutex>
 #include <memory>
 #include <FileUtil.hpp>
+#include <LogIndex.hpp>
+#include <cstdint>
 #include <ctime>
 
+class LogCompressor;
+
 class LogFile
 {
 public:
@@ -18,7 +22,18 @@ public:
      */
     LogFile(const std::string &basename, off_t rollSize, int flushInterval = 3,
             int checkEveryN_ = 1024);
-    ~LogFile() = default;
+    // 当前文件也交给压缩线程
+    ~LogFile();
+
+    // 滚动后的旧文件交给compressor在后台压缩 不转移所有权 compressor要比LogFile活得久
+    void setCompressor(LogCompressor *compressor) { compressor_ = compressor; }
+
+    /**
+     * @brief 为日志文件生成时间索引(见LogIndex.hpp) 写满bytes字节或者超过1秒切一块
+     * 只有appendv给出了时间的数据才有准确的时间范围 其余的块时间范围记为不限
+     * @param bytes 块大小 0表示不生成索引
+     */
+    void setIndexInterval(off_t bytes);
 
     /**
      * @brief 追加数据到日志文件
@@ -27,6 +42,17 @@ public:
      */
     void append(const char *data, int len);
 
+    /**
+     * @brief 把多段数据一次写入日志文件(pwritev 不经过缓冲区拷贝)
+     * 整批写完之后才检查是否需要滚动 所以一批数据总是在同一个文件中
+     * @param iov 数据段
+     * @param count 段数
+     * @param minTime 这批日志中最早的时间(微秒) 用于时间索引 minTime > maxTime表示不知道
+     * @param maxTime 这批日志中最晚的时间(微秒)
+     */
+    void appendv(const struct iovec *iov, int count, int64_t minTime = INT64_MAX,
+                 int64_t maxTime = INT64_MIN);
+
     /**
      * @brief 强制将缓冲区数据刷新到磁盘
      */
@@ -35,10 +61,14 @@ public:
     /**
      * @brief 滚动日志文件
      * 当日志文件大小超过rollsize_或时间超过一天时，创建新的日志文件
+     * 新文件预分配rollSize_字节 写入时不用再扩展磁盘空间
      * @return 是否成功滚动日志文件
      */
     bool rollFile();
 
+    // 已经打开过的日志文件个数 每次滚动加一 用于判断两次写入之间是否换了文件
+    int fileCount() const { return fileCount_; }
+
 private:
     /**
      * @brief 生成日志文件名
@@ -55,17 +85,35 @@ private:
      */
     void appendInlock(const char *data, int len);
 
+    // 写入之后检查是否需要滚动和刷新
+    void checkRollAndFlush();
+
+    // 把新写入数据的时间并入当前块 块足够大或者足够久时写出索引项
+    void updateIndex(int64_t minTime, int64_t maxTime);
+    // 写出当前块的索引项 开始新的一块
+    void closeBlock();
+
     const std::string basename_; // 文件基本名称（不带日期）
     const off_t rollSize_;       // 滚动文件大小
     const int flushInterval_;    // 日志刷新间隔，默认3s
     const int checkEveryN_;      // 写数据次数限制，默认1024
 
     int count_; // 写入次数计数，超过限制值checkEveryN_时清除，然后重新计数
+    int fileCount_; // 已经打开过的日志文件个数
 
     std::mutex mutex_;
     time_t startOfPeriod_; // 本次写log周期的起始时间（秒）
     time_t lastRoll_;      // 上次roll日志文件的时间（秒）
     time_t lastFlush_;     // 上次flush日志文件的时间（秒）
     std::unique_ptr<FileUtil> file_;
+    std::string filename_;       // 当前文件名
+    LogCompressor *compressor_;  // 为nullptr时不压缩
+
+    LogIndex::Writer index_; // 当前文件的索引
+    off_t indexInterval_;    // 索引块大小 0表示不生成索引
+    off_t blockStart_;       // 当前块的起始位置
+    time_t blockStartTime_;  // 当前块开始的时间(秒)
+    int64_t blockMinTime_;   // 当前块中最早的日志时间 还不知道时为INT64_MAX
+    int64_t blockMaxTime_;   // 当前块中最晚的日志时间 还不知道时为INT64_MIN
     const static int kRollPerSeconds_ = 60 * 60 * 24;
 };
\ No newline at end of file
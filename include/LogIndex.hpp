@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * 日志文件的稀疏时间索引 与日志文件放在一起 文件名为日志文件名加".idx"
+ * 1. 日志文件按写入顺序切成块(每块约N KB或者不超过1秒) 每块一条索引: 块的起始位置和块中日志的最早/最晚时间
+ *    同一块中不同线程的日志时间可能交错 所以记录的是时间范围而不是单个时间点
+ * 2. LogCompressor压缩时每块压成一个独立的gzip member 生成"xxx.log.gz.idx" 其中的位置是.gz文件中的位置
+ *    按索引只需要解压命中的块 整个.gz文件仍然可以直接用zcat查看
+ * 3. tools/LogQuery按索引从日志文件(包括压缩后的)中取出一个时间段的日志
+ **/
+namespace LogIndex
+{
+    const char kSuffix[] = ".idx";
+
+    // 时间都是自Epoch起的微秒数
+    struct Entry
+    {
+        int64_t offset;  // 块在文件中的起始位置 块一直到下一条索引的位置(或文件末尾)
+        int64_t minTime; // 块中最早的日志时间
+        int64_t maxTime; // 块中最晚的日志时间
+    };
+
+    /**
+     * 解析日志行开头的时间"2026/10/17 04:33:03.059577"(本地时间 见Timestamp::formatTo)
+     * 缓存上一次的年月日时分秒 同一秒内只解析微秒 不是线程安全的
+     * 没有微秒部分("2026/10/17 04:33:03")也可以解析 用于查询参数
+     */
+    class TimeParser
+    {
+    public:
+        TimeParser() : cachedSeconds_(0) { cachedPrefix_[0] = '\0'; }
+        // 成功时把时间写入micros并返回true
+        bool parse(const char *line, size_t len, int64_t *micros);
+
+    private:
+        static const size_t kPrefixSize = 19; // "2026/10/17 04:33:03"
+        char cachedPrefix_[kPrefixSize + 1];
+        int64_t cachedSeconds_;
+    };
+
+    // 读取索引文件 文件不存在或者格式不对时返回false
+    bool load(const std::string &path, std::vector<Entry> *entries);
+
+    // 顺序追加索引项 每项直接write 索引项很少(每块一项) 不需要缓冲
+    class Writer
+    {
+    public:
+        Writer() : fd_(-1) {}
+        ~Writer() { close(); }
+
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        // 打开(不存在时创建)索引文件 接在原有索引之后追加 与FileUtil接着写同名日志文件相对应
+        bool open(const std::string &path);
+        void append(const Entry &entry);
+        void close();
+        bool isOpen() const { return fd_ >= 0; }
+
+    private:
+        int fd_;
+    };
+} // namespace LogIndex
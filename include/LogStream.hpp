@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <FixedBuffer.hpp>
 
 class GeneralTemplate
@@ -10,14 +12,78 @@ public:
         : data_(data), len_(len) {}
 
 private:
+    friend class LogStream;
     const char *data_;
     size_t len_;
 };
 
+// 以十六进制输出整数 带"0x"前缀 width为最少的数字位数 不足时补0
+// LOG_INFO << Hex(events) => "0x19"  Hex(mask, 8) => "0x0000ffff" 负数按对应的无符号数输出
+class Hex
+{
+public:
+    template <typename T>
+    explicit Hex(T value, int width = 0)
+        : value_(static_cast<typename std::make_unsigned<T>::type>(value)), width_(width)
+    {
+        static_assert(std::is_integral<T>::value, "Hex only accepts integers");
+    }
+
+private:
+    friend class LogStream;
+    uint64_t value_;
+    int width_;
+};
+
+// 定点小数 precision为小数位数 LOG_INFO << Fixed(ms, 3) => "12.345"
+class Fixed
+{
+public:
+    Fixed(double value, int precision) : value_(value), precision_(precision) {}
+
+private:
+    friend class LogStream;
+    double value_;
+    int precision_;
+};
+
+// 定宽整数 右对齐 不足width时在左边补fill(为'0'时补在负号之后)
+// LOG_INFO << Padded(fd, 5) => "   42"  Padded(-7, 4, '0') => "-007"
+class Padded
+{
+public:
+    template <typename T>
+    Padded(T value, int width, char fill = ' ')
+        : negative_(isNegative(value)),
+          magnitude_(negative_ ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value)),
+          width_(width), fill_(fill)
+    {
+        static_assert(std::is_integral<T>::value, "Padded only accepts integers");
+    }
+
+private:
+    friend class LogStream;
+    template <typename T>
+    static bool isNegative(T value) { return std::is_signed<T>::value && value < T(); }
+
+    bool negative_;
+    uint64_t magnitude_;
+    int width_;
+    char fill_;
+};
+
 class LogStream
 {
 public:
-    using Buffer = FixedBuffer<kSmallBufferSize>;
+    using Buffer = LogBuffer;
+
+    // 默认格式化到内部的kSmallBufferSize字节存储中
+    LogStream() : buffer_(storage_, sizeof(storage_)) {}
+    LogStream(const LogStream &) = delete;
+    LogStream &operator=(const LogStream &) = delete;
+
+    // 改为格式化到外部的内存中(比如日志后端预留的空间) 之前写入的内容被丢弃
+    void attach(char *data, size_t capacity) { buffer_ = Buffer(data, capacity); }
 
     // 将指定长度的字符数据追加到缓冲区
     void append(const char *buffer, int len)
@@ -49,8 +115,14 @@ public:
     LogStream &operator<<(long long);
     LogStream &operator<<(unsigned long long);
 
+    // 浮点数按能够还原出原值的最短形式输出(std::to_chars)
     LogStream &operator<<(float);
     LogStream &operator<<(double);
+    // 指针以十六进制输出 "0x7ffc..." 字符串指针仍按字符串输出
+    LogStream &operator<<(const void *);
+    LogStream &operator<<(const Hex &h);
+    LogStream &operator<<(const Fixed &f);
+    LogStream &operator<<(const Padded &p);
 
     LogStream &operator<<(char);
     LogStream &operator<<(const char *);
@@ -65,7 +137,10 @@ private:
     // 对于整型需要特殊的处理，模板函数用于格式化整型
     template <typename T>
     void formatInteger(T num);
+    // 十六进制 最少width位
+    void formatHex(uint64_t value, int width);
 
+    char storage_[kSmallBufferSize]; // 内部存储 没有外部内存时使用
     // 内部缓冲区对象
     Buffer buffer_;
 };
\ No newline at end of file
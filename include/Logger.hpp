@@ -1,5 +1,7 @@
 #pragma once
 #include <LogStream.hpp>
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <string.h>
 #include <Timestamp.hpp>
@@ -26,6 +28,23 @@ public:
     int size_;
 };
 
+/**
+ * 支持就地格式化的日志后端(比如AsynLogging)
+ * Logger直接在reserve返回的内存中格式化一条日志 析构时commit 整条日志只写一次 不再经过OutputFunc拷贝
+ * reserve和commit在同一个线程中成对调用
+ **/
+class LogSink
+{
+public:
+    virtual ~LogSink() = default;
+    // 预留至少len字节的连续内存 后端不可用时返回nullptr Logger退回到OutputFunc
+    virtual char *reserve(size_t len) = 0;
+    // 提交reserve得到的内存中实际写入的len字节 kind为记录类型(见BinaryLog::RecordKind) 文本日志为0
+    virtual void commit(const char *data, size_t len, uint32_t kind = 0) = 0;
+    // 把已提交的日志尽快写出 FATAL终止程序之前调用
+    virtual void flush() {}
+};
+
 class Logger
 {
 public:
@@ -48,6 +67,17 @@ public:
     using FlushFunc = std::function<void()>;
     static void setOutput(OutputFunc);
     static void setFlush(FlushFunc);
+    // 设置就地格式化的日志后端 nullptr表示不使用 优先于OutputFunc
+    static void setSink(LogSink *sink);
+
+    // 全局运行时日志等级 低于该等级的日志在求值参数之前就被跳过 默认INFO 超过FATAL的值按FATAL处理
+    static LogLevel logLevel();
+    static void setLogLevel(LogLevel level);
+    // 设置模块的日志等级 模块名为源文件名去掉目录和后缀(如"EPollPoller") 或者LOG_MODULE的值
+    // 返回匹配到的模块个数
+    static int setModuleLevel(const char *module, LogLevel level);
+    // 模块恢复跟随全局等级
+    static int resetModuleLevel(const char *module);
 
 private:
     class Impl
@@ -60,6 +90,7 @@ private:
 
         Timestamp time_;
         LogStream stream_;
+        LogSink *sink_; // 日志直接格式化在sink_预留的内存中 为nullptr时使用stream_自己的存储
         LogLevel level_;
         int line_;
         SourceFile basename_;
@@ -70,16 +101,91 @@ private:
 
 const char *getErrnoMsg(int savedErrno);
 
+// 全局日志等级 由Logger::setLogLevel修改 放在头文件中是为了让等级判断内联
+extern std::atomic<int> g_logLevel;
+// Logger::setSink设置的后端
+extern LogSink *g_sink;
+
 /**
- * 当日志等级小于对应等级才会输出
- * 比如设置等级为FATAL，则logLevel等级大于DEBUG和INFO，DEBUG和INFO等级的日志就不会输出
+ * 日志模块 每个源文件(翻译单元)有一个 保存该模块的运行时日志等级
+ * 等级为kInherit时跟随全局等级 可以单独调高或调低某个模块的等级
+ * 零初始化的状态就是kInherit 所以静态初始化期间打日志也是安全的
+ **/
+class LogModule
+{
+public:
+    static const int kInherit = 0; // level_中保存的是等级+1 0表示跟随全局等级
+
+    explicit LogModule(const char *path);
+    ~LogModule();
+
+    LogModule(const LogModule &) = delete;
+    LogModule &operator=(const LogModule &) = delete;
+
+    // 该模块是否输出level等级的日志 两次relaxed读 不加锁 FATAL总是输出(之后终止程序)
+    bool enabled(Logger::LogLevel level) const
+    {
+        if (level >= Logger::FATAL)
+        {
+            return true;
+        }
+        int moduleLevel = level_.load(std::memory_order_relaxed);
+        int threshold = moduleLevel == kInherit
+                            ? g_logLevel.load(std::memory_order_relaxed)
+                            : moduleLevel - 1;
+        return level >= threshold;
+    }
+
+    const char *name() const { return name_; }
+
+private:
+    friend class Logger;
+
+    char name_[64];         // 模块名
+    std::atomic<int> level_; // 等级+1 或kInherit
+    LogModule *next_;       // 所有模块串成一个链表 修改等级时按名字查找
+};
+
+/**
+ * 编译期最低日志等级 低于该等级的日志语句条件恒为假 整个语句被编译器删除 参数也不会求值
+ * 取值为Logger::LogLevel的数值 0=TRACE 1=DEBUG 2=INFO 3=WARN 4=ERROR 5=FATAL
+ * 未定义OPEN_LOGGING时只保留FATAL 致命错误仍然会输出并终止程序
  */
+#ifndef LOG_MIN_LEVEL
 #ifdef OPEN_LOGGING
-#define LOG_DEBUG Logger(__FILE__, __LINE__, Logger::DEBUG).stream();
-#define LOG_INFO Logger(__FILE__, __LINE__, Logger::INFO).stream();
-#define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN).stream();
-#define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR).stream();
-#define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL).stream();
+#define LOG_MIN_LEVEL 0
 #else
-#define LOG(level) LogStream()
-#endif
\ No newline at end of file
+#define LOG_MIN_LEVEL 5
+#endif
+#endif
+
+/**
+ * 当前源文件所属的日志模块 默认以源文件名命名 包含Logger.hpp之前定义LOG_MODULE可以自定义模块名
+ * 匿名命名空间保证每个翻译单元各有一个
+ */
+#ifndef LOG_MODULE
+#define LOG_MODULE __BASE_FILE__
+#endif
+namespace
+{
+    LogModule g_thisLogModule(LOG_MODULE);
+}
+
+/**
+ * 当日志等级不低于编译期和运行时的等级才会输出
+ * 比如设置等级为WARN，则DEBUG和INFO等级的日志就不会输出 <<右边的参数也不会被求值
+ * 写成if-else的形式 日志语句出现在用户的if/else中时else不会和宏里的if配对
+ */
+#define LOG_IF_ENABLED(level)                                          \
+    if ((level) < LOG_MIN_LEVEL || !g_thisLogModule.enabled(level)) \
+    {                                                                  \
+    }                                                                  \
+    else                                                               \
+        Logger(__FILE__, __LINE__, level).stream()
+
+#define LOG_TRACE LOG_IF_ENABLED(Logger::TRACE)
+#define LOG_DEBUG LOG_IF_ENABLED(Logger::DEBUG)
+#define LOG_INFO LOG_IF_ENABLED(Logger::INFO)
+#define LOG_WARN LOG_IF_ENABLED(Logger::WARN)
+#define LOG_ERROR LOG_IF_ENABLED(Logger::ERROR)
+#define LOG_FATAL LOG_IF_ENABLED(Logger::FATAL)
\ No newline at end of file
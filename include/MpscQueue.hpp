@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+
+/**
+ * 侵入式无锁多生产者单消费者队列(Dmitry Vyukov的MPSC算法)
+ * 1. 生产者入队只有一次atomic exchange和一次store 不加锁 不会互相等待
+ * 2. 队列元素由使用者继承Node 节点的分配和释放由使用者负责
+ * 3. pop只能由唯一的消费者线程调用 生产者入队进行到一半时pop可能暂时返回nullptr
+ *    此时该生产者随后一定会完成入队 使用者需要自行保证之后还会再来pop(EventLoop中由wakeup保证)
+ **/
+class MpscQueue
+{
+public:
+    struct Node
+    {
+        Node() : next_(nullptr) {}
+        std::atomic<Node *> next_;
+    };
+
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+
+    // 入队 任意线程都可以调用
+    void push(Node *node)
+    {
+        node->next_.store(nullptr, std::memory_order_relaxed);
+        // 先抢占队尾 再把前一个节点链接过来 两步之间其他生产者可以继续入队
+        Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next_.store(node, std::memory_order_release);
+    }
+
+    // 出队 只能在消费者线程调用 队列为空(或者生产者入队尚未完成)时返回nullptr
+    Node *pop()
+    {
+        Node *tail = tail_;
+        Node *next = tail->next_.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(std::memory_order_acquire);
+        }
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+        // tail是最后一个已链接的节点 如果它不是队尾 说明有生产者入队进行到一半
+        if (tail != head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        // tail是唯一的元素 把stub_放回队尾后才能把tail取出
+        push(&stub_);
+        next = tail->next_.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    // 当前最后入队的节点 队列为空时返回nullptr 消费者用它来限定一批要处理的元素
+    Node *back() const
+    {
+        Node *head = head_.load(std::memory_order_acquire);
+        return head == &stub_ ? nullptr : head;
+    }
+
+private:
+    // 生产者和消费者访问的成员放在不同的cache line上 避免伪共享
+    alignas(64) std::atomic<Node *> head_; // 队尾 生产者在这一端入队
+    alignas(64) Node *tail_;               // 队头 只有消费者访问
+    Node stub_;                            // 哨兵节点 保证队列中至少有一个节点
+};
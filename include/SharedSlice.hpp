@@ -0,0 +1,113 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+/**
+ * 不可变的引用计数字节块 用于广播/扇出: 同一份消息发给成千上万个连接时只拷贝一次
+ * 1. copyFrom一次分配(计数+长度+数据在同一块内存中)并拷贝数据 之后只读
+ * 2. 拷贝SharedSlice只增加引用计数 TcpConnection::send(slice)把它放进输出队列 writev直接引用这块内存
+ * 3. 写完后由连接所在的loop线程释放引用 最后一个引用释放时回收内存 计数是原子的 可以在任意线程拷贝/释放
+ * 4. subslice引用同一块内存中的一段 用于部分写出后剩下的部分 或者把一条消息拆成头和体
+ **/
+class SharedSlice
+{
+public:
+    SharedSlice() noexcept : block_(nullptr), data_(nullptr), size_(0) {}
+
+    // 拷贝data生成一个新的块
+    static SharedSlice copyFrom(const void *data, size_t len)
+    {
+        void *mem = ::operator new(sizeof(Block) + len);
+        Block *block = new (mem) Block();
+        char *payload = reinterpret_cast<char *>(block + 1);
+        if (len > 0)
+        {
+            ::memcpy(payload, data, len);
+        }
+        return SharedSlice(block, payload, len);
+    }
+    static SharedSlice copyFrom(const std::string &str) { return copyFrom(str.data(), str.size()); }
+
+    SharedSlice(const SharedSlice &rhs) noexcept
+        : block_(rhs.block_), data_(rhs.data_), size_(rhs.size_)
+    {
+        retain();
+    }
+    SharedSlice(SharedSlice &&rhs) noexcept
+        : block_(rhs.block_), data_(rhs.data_), size_(rhs.size_)
+    {
+        rhs.block_ = nullptr;
+        rhs.data_ = nullptr;
+        rhs.size_ = 0;
+    }
+    SharedSlice &operator=(SharedSlice rhs) noexcept
+    {
+        swap(rhs);
+        return *this;
+    }
+    ~SharedSlice() { release(); }
+
+    void swap(SharedSlice &rhs) noexcept
+    {
+        std::swap(block_, rhs.block_);
+        std::swap(data_, rhs.data_);
+        std::swap(size_, rhs.size_);
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 共享同一块内存的[offset, offset + len) 超出范围的部分截掉
+    SharedSlice subslice(size_t offset, size_t len = std::string::npos) const
+    {
+        if (offset > size_)
+        {
+            offset = size_;
+        }
+        if (len > size_ - offset)
+        {
+            len = size_ - offset;
+        }
+        retain();
+        return SharedSlice(block_, data_ + offset, len);
+    }
+
+    // 当前引用数 只用于统计和调试
+    long useCount() const { return block_ ? block_->refs.load(std::memory_order_relaxed) : 0; }
+
+private:
+    struct Block
+    {
+        Block() : refs(1) {}
+        std::atomic<long> refs;
+    };
+
+    SharedSlice(Block *block, const char *data, size_t len) noexcept
+        : block_(block), data_(data), size_(len) {}
+
+    void retain() const
+    {
+        if (block_)
+        {
+            block_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    void release()
+    {
+        // 与shared_ptr相同: 释放时acq_rel 保证其他线程对数据的读取都发生在回收之前
+        if (block_ && block_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            block_->~Block();
+            ::operator delete(block_);
+        }
+    }
+
+    Block *block_;
+    const char *data_;
+    size_t size_;
+};
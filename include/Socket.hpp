@@ -0,0 +1,38 @@
+#pragma once
+#include <sys/socket.h>
+
+class InetAddress;
+
+// 持有一个socket fd 析构时关闭
+class Socket
+{
+public:
+    explicit Socket(int sockfd) : sockfd_(sockfd) {}
+    ~Socket();
+
+    Socket(const Socket &) = delete;
+    Socket &operator=(const Socket &) = delete;
+
+    // 创建非阻塞、close-on-exec的TCP socket 失败时LOG_FATAL
+    static int createNonblocking(sa_family_t family);
+
+    int fd() const { return sockfd_; }
+    void bindAddress(const InetAddress &localaddr);
+    void listen();
+    // 接受一个连接 返回非阻塞、close-on-exec的fd 失败返回-1 errno保持不变
+    int accept(InetAddress *peeraddr);
+
+    // 关闭写端 已经在发送缓冲区中的数据仍会发出
+    void shutdownWrite();
+
+    void setTcpNoDelay(bool on);
+    void setReuseAddr(bool on);
+    void setReusePort(bool on);
+    void setKeepAlive(bool on);
+
+    // 取出并清除socket上待处理的错误(SO_ERROR)
+    static int getSocketError(int sockfd);
+
+private:
+    const int sockfd_;
+};
@@ -0,0 +1,348 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <stdio.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * 单生产者单消费者的无锁字节环形缓冲区 存放变长记录
+ * 1. 生产者reserve一段连续空间 直接在其中写入(格式化)数据 再commit实际长度 数据只写一次
+ * 2. 每条记录有8字节的头(长度+类型) 按8字节对齐 尾部剩余空间放不下时写一个回绕标记跳到开头
+ *    保证每条记录在内存中都是连续的
+ * 3. head_只有生产者写 tail_只有消费者写 各自缓存对方的位置 只有空间不够时才去读对方的cache line
+ * 4. reserve和commit必须成对调用 中间不能再reserve
+ * 5. 内存用mmap分配 不小于2MB时按2MB对齐并建议使用透明大页 构造时预先写一遍所有页面
+ *    写日志时不会再因为第一次访问新页面而缺页
+ * 6. 指定文件时 数据和读写位置都放在MAP_SHARED映射的文件中 进程崩溃(SIGSEGV/abort)后
+ *    还没有消费的记录仍在文件里 不需要进程做任何I/O 下次启动时用recover()取出
+ *    只能防进程崩溃 不能防断电/系统崩溃 文件放在/dev/shm下可以避免内核回写磁盘
+ **/
+class SpscRing
+{
+public:
+    static const size_t kHeaderSize = 8; // 记录头大小
+
+    // 容量向上取整到2的幂 path不为空时映射到该文件(文件已存在时覆盖 创建失败时退回匿名内存)
+    explicit SpscRing(size_t capacity, const std::string &path = std::string())
+        : control_(nullptr), head_(0), cachedTail_(0), pendingStart_(0), tail_(0)
+    {
+        size_t cap = 4096;
+        while (cap < capacity)
+        {
+            cap <<= 1;
+        }
+        capacity_ = cap;
+        mask_ = cap - 1;
+        buffer_ = path.empty() ? nullptr : map(path);
+        if (buffer_ == nullptr)
+        {
+            buffer_ = allocate(cap);
+        }
+    }
+
+    ~SpscRing()
+    {
+        if (control_)
+        {
+            // 正常销毁时记录都已消费 文件不再需要
+            if (empty())
+            {
+                ::unlink(path_.c_str());
+            }
+            ::munmap(control_, kControlSize + capacity_);
+        }
+        else
+        {
+            ::munmap(buffer_, capacity_);
+        }
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // 已提交但还未被消费的字节数(含记录头) 任意线程读取都只是近似值
+    size_t used() const
+    {
+        return static_cast<size_t>(head_.load(std::memory_order_acquire) -
+                                   tail_.load(std::memory_order_acquire));
+    }
+
+    /**
+     * 生产者: 预留一段至少len字节的连续空间 空间不足时返回nullptr
+     * 返回的指针8字节对齐
+     */
+    char *reserve(size_t len)
+    {
+        size_t record = recordSize(len);
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(pos & mask_);
+        size_t contiguous = capacity_ - offset;
+        size_t pad = contiguous < record ? contiguous : 0; // 尾部放不下时跳过的字节
+        size_t total = pad + record;
+        if (total > capacity_)
+        {
+            return nullptr;
+        }
+        if (capacity_ - (pos - cachedTail_) < total)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (capacity_ - (pos - cachedTail_) < total)
+            {
+                return nullptr;
+            }
+        }
+        if (pad)
+        {
+            // 回绕标记随commit一起发布
+            uint32_t marker = kWrapMarker;
+            ::memcpy(buffer_ + offset, &marker, sizeof(marker));
+        }
+        pendingStart_ = pos + pad;
+        return buffer_ + static_cast<size_t>(pendingStart_ & mask_) + kHeaderSize;
+    }
+
+    /**
+     * 生产者: 提交最近一次reserve的空间中实际写入的len字节 len不能超过reserve时的长度
+     * kind由使用者定义 消费时原样交回 返回提交后已使用的字节数
+     * 已使用超过一半时才重新读取消费位置 否则按缓存的消费位置估算(只会偏大)
+     */
+    size_t commit(size_t len, uint32_t kind = 0)
+    {
+        char *record = buffer_ + static_cast<size_t>(pendingStart_ & mask_);
+        uint32_t header[2] = {static_cast<uint32_t>(len), kind};
+        ::memcpy(record, header, sizeof(header));
+        uint64_t head = pendingStart_ + recordSize(len);
+        head_.store(head, std::memory_order_release);
+        if (control_)
+        {
+            // 记录内容已经在文件中 更新文件中的位置之后崩溃也能找到它
+            control_->head.store(head, std::memory_order_release);
+        }
+        if (head - cachedTail_ > capacity_ / 2)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+        }
+        return static_cast<size_t>(head - cachedTail_);
+    }
+
+    /**
+     * 消费者: 依次处理所有已提交的记录 对每条记录调用f(data, len, kind)
+     * 全部处理完之后才释放空间 处理期间记录的内存保持有效 返回处理的记录条数
+     */
+    template <typename F>
+    size_t consume(F &&f)
+    {
+        size_t count = 0;
+        release(peek(f, &count));
+        return count;
+    }
+
+    /**
+     * 消费者: 和consume一样处理所有已提交的记录 但不释放空间 返回处理到的位置
+     * 记录的内存在release(位置)之前一直有效 可以先收集多个缓冲区的记录再一起写出
+     */
+    template <typename F>
+    uint64_t peek(F &&f, size_t *count = nullptr)
+    {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        while (pos != head)
+        {
+            size_t offset = static_cast<size_t>(pos & mask_);
+            uint32_t header[2];
+            ::memcpy(header, buffer_ + offset, sizeof(header));
+            if (header[0] == kWrapMarker)
+            {
+                pos += capacity_ - offset;
+                continue;
+            }
+            f(buffer_ + offset + kHeaderSize, static_cast<size_t>(header[0]), header[1]);
+            pos += recordSize(header[0]);
+            if (count)
+            {
+                ++*count;
+            }
+        }
+        return pos;
+    }
+
+    // 消费者: 释放peek处理过的记录 pos为peek的返回值
+    void release(uint64_t pos)
+    {
+        tail_.store(pos, std::memory_order_release);
+        if (control_)
+        {
+            control_->tail.store(pos, std::memory_order_release);
+        }
+    }
+
+    /**
+     * 从映射文件中取出上次运行没有消费的记录 对每条记录调用f(data, len, kind)
+     * 返回记录条数 文件不存在或者不是环形缓冲区文件时返回-1 遇到损坏的记录时停止
+     */
+    template <typename F>
+    static long recover(const std::string &path, F &&f)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > kControlSize)
+        {
+            p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            return -1;
+        }
+        const Control *control = static_cast<const Control *>(p);
+        const char *buffer = static_cast<const char *>(p) + kControlSize;
+        size_t capacity = static_cast<size_t>(control->capacity);
+        long count = -1;
+        if (::memcmp(control->magic, kMagic, sizeof(kMagic)) == 0 &&
+            capacity != 0 && (capacity & (capacity - 1)) == 0 &&
+            kControlSize + capacity <= static_cast<size_t>(st.st_size))
+        {
+            count = 0;
+            uint64_t head = control->head.load(std::memory_order_acquire);
+            uint64_t pos = control->tail.load(std::memory_order_acquire);
+            while (pos < head && head - pos <= capacity)
+            {
+                size_t offset = static_cast<size_t>(pos & (capacity - 1));
+                uint32_t header[2];
+                ::memcpy(header, buffer + offset, sizeof(header));
+                if (header[0] == kWrapMarker)
+                {
+                    pos += capacity - offset;
+                    continue;
+                }
+                if (offset + recordSize(header[0]) > capacity || pos + recordSize(header[0]) > head)
+                {
+                    break;
+                }
+                f(buffer + offset + kHeaderSize, static_cast<size_t>(header[0]), header[1]);
+                pos += recordSize(header[0]);
+                ++count;
+            }
+        }
+        ::munmap(p, st.st_size);
+        return count;
+    }
+
+    // 消费者: 是否没有待处理的记录
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const uint32_t kWrapMarker = 0xffffffff;
+    static const size_t kControlSize = 4096; // 映射文件开头的控制块大小
+    static constexpr char kMagic[16] = "webserver-ring1";
+
+    // 映射文件的控制块 读写位置各占一个cache line
+    struct Control
+    {
+        char magic[16];
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+
+    static size_t recordSize(size_t len) { return (kHeaderSize + len + 7) & ~static_cast<size_t>(7); }
+
+    static char *allocate(size_t size)
+    {
+        const size_t kHugePageSize = 2 * 1024 * 1024;
+        size_t align = size >= kHugePageSize ? kHugePageSize : 0;
+        void *p = ::mmap(nullptr, size + align, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        char *base = static_cast<char *>(p);
+        if (align)
+        {
+            // 多映射一个大页 截掉首尾 得到按大页对齐的区域
+            char *aligned = reinterpret_cast<char *>(
+                (reinterpret_cast<uintptr_t>(base) + align - 1) & ~(align - 1));
+            if (aligned > base)
+            {
+                ::munmap(base, aligned - base);
+            }
+            ::munmap(aligned + size, base + align - aligned);
+            base = aligned;
+            ::madvise(base, size, MADV_HUGEPAGE);
+        }
+        // 预先触发缺页 每页写一个字节
+        for (size_t offset = 0; offset < size; offset += 4096)
+        {
+            base[offset] = 0;
+        }
+        return base;
+    }
+
+    // 映射文件 返回数据区 失败时返回nullptr
+    char *map(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            fprintf(stderr, "SpscRing: open %s failed %s\n", path.c_str(), strerror(errno));
+            return nullptr;
+        }
+        size_t size = kControlSize + capacity_;
+        void *p = MAP_FAILED;
+        // fallocate保证写入映射时不会因为磁盘空间不足收到SIGBUS
+        if (::ftruncate(fd, static_cast<off_t>(size)) == 0 &&
+            ::posix_fallocate(fd, 0, static_cast<off_t>(size)) == 0)
+        {
+            p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+        }
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            fprintf(stderr, "SpscRing: map %s failed %s\n", path.c_str(), strerror(errno));
+            ::unlink(path.c_str());
+            return nullptr;
+        }
+        control_ = new (p) Control;
+        ::memcpy(control_->magic, kMagic, sizeof(kMagic));
+        control_->capacity = capacity_;
+        control_->head.store(0, std::memory_order_relaxed);
+        control_->tail.store(0, std::memory_order_relaxed);
+        path_ = path;
+        return static_cast<char *>(p) + kControlSize;
+    }
+
+    Control *control_; // 映射文件的控制块 使用匿名内存时为nullptr
+    std::string path_;
+    char *buffer_;
+    size_t capacity_;
+    size_t mask_;
+
+    // 生产者独占的cache line
+    alignas(64) std::atomic<uint64_t> head_; // 已提交的写入位置
+    uint64_t cachedTail_;                   // 生产者看到的消费位置
+    uint64_t pendingStart_;                 // 最近一次reserve的记录起始位置
+
+    // 消费者独占的cache line
+    alignas(64) std::atomic<uint64_t> tail_; // 已消费的位置
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+#include <Callbacks.hpp>
+#include <FileHandle.hpp>
+#include <SharedSlice.hpp>
+
+class Channel;
+class EventLoop;
+
+/**
+ * 静态文件缓存 每个EventLoop一个分片 只在所属loop线程中查找 不需要加锁
+ * 1. 缓存打开的fd和fstat结果 命中时不再有open/fstat/close
+ * 2. 不超过smallFileLimit的文件整个读入内存 和预先生成的响应头拼成一个SharedSlice 命中时一次send
+ *    大文件只缓存响应头和fd 用sendFile发送
+ * 3. 每个缓存的文件加一个inotify watch inotify fd作为Channel注册在loop上
+ *    文件被修改、改属性(包括被rename覆盖/删除时的链接数变化)、移动时丢弃对应的项 下一次查找重新打开
+ *    watch在open之前添加 加载过程中发生的修改也会使刚加入的项失效 无法添加watch时不缓存
+ * 4. 项数和内存超过上限时按LRU淘汰 淘汰或失效的项如果还在发送中 由连接持有的引用保证fd和内存有效
+ * 5. 统计计数是原子变量 监控线程可以随时读取stats() 各分片的结果相加即为总数
+ *
+ * 用法: 作为loop的context 随loop一起析构(析构时要从poller中移除inotify的channel)
+ *   server.setThreadInitCallback([](EventLoop *loop)
+ *                                { loop->setContext(std::make_shared<StaticFileCache>(loop, "/var/www")); });
+ *   // 消息回调(在连接的loop线程中)
+ *   StaticFileCache *cache = static_cast<StaticFileCache *>(conn->getLoop()->getContext().get());
+ *   StaticFileCache::EntryPtr entry = cache->lookup(path);
+ *   if (entry) StaticFileCache::sendEntry(conn, entry); else ...404
+ **/
+class StaticFileCache
+{
+public:
+    struct Options
+    {
+        Options() : maxEntries(4096), maxMemoryBytes(64 * 1024 * 1024), smallFileLimit(64 * 1024) {}
+
+        size_t maxEntries;     // 最多缓存的文件数 也是打开的fd数的上限
+        size_t maxMemoryBytes; // 内存中的文件内容和响应头的总大小上限
+        size_t smallFileLimit; // 不超过这个大小的文件整个放进内存
+    };
+
+    // 缓存项 创建后只读
+    struct Entry
+    {
+        std::string path;   // 相对于根目录的路径
+        FileHandlePtr file; // 大文件打开的fd 发送期间由连接持有引用 小文件读入内存后不保留fd
+        off_t size;
+        int64_t mtimeNs;    // 修改时间 纳秒
+        std::string etag;   // 带引号的强ETag 由inode、大小和修改时间生成
+        SharedSlice header; // "HTTP/1.1 200 OK" 加上Content-Length/Content-Type/Last-Modified/ETag 以空行结尾
+        SharedSlice response; // 小文件为响应头加文件内容(header引用其中的开头部分) 大文件为空
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0; // inotify引起的失效
+        uint64_t evictions = 0;     // LRU淘汰
+        size_t entries = 0;
+        size_t memoryBytes = 0;     // 缓存的文件内容和响应头 不含容器本身的开销
+        double hitRatio() const { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses); }
+    };
+
+    // 在loop线程中构造(比如ThreadInitCallback中) 在loop析构之前析构 root为根目录 打开失败时LOG_FATAL
+    StaticFileCache(EventLoop *loop, const std::string &root, const Options &options = Options());
+    ~StaticFileCache();
+
+    StaticFileCache(const StaticFileCache &) = delete;
+    StaticFileCache &operator=(const StaticFileCache &) = delete;
+
+    /**
+     * 查找相对于根目录的path(可以带开头的'/') 只能在loop线程中调用
+     * 不存在、不是普通文件或者包含".."时返回nullptr 不缓存查找失败的结果
+     */
+    EntryPtr lookup(const std::string &path);
+
+    // 发送整个响应: 小文件一次send(response) 大文件send(header)后sendFile
+    static void sendEntry(const TcpConnectionPtr &conn, const EntryPtr &entry);
+
+    // 可以跨线程调用
+    Stats stats() const;
+
+private:
+    using LruList = std::list<EntryPtr>;
+
+    struct Slot
+    {
+        LruList::iterator lru;
+        int wd; // inotify watch描述符 -1表示没有
+    };
+
+    EntryPtr load(const std::string &path);
+    void insert(const EntryPtr &entry, int wd);
+    void erase(const std::string &path);
+    void evict();
+    void clear();
+    // 没有路径再使用wd时删除watch
+    void releaseWatch(int wd, const std::string &path);
+    void handleInotify();
+    void updateStats();
+    // 小文件的header引用response中的内存 不重复计算
+    static size_t memoryOf(const Entry &entry)
+    {
+        return entry.response.empty() ? entry.header.size() : entry.response.size();
+    }
+
+    EventLoop *loop_;
+    const std::string root_;
+    const Options options_;
+    int rootFd_;
+    int inotifyFd_;
+    std::unique_ptr<Channel> inotifyChannel_;
+
+    LruList lru_; // 最近使用的在前
+    std::unordered_map<std::string, Slot> entries_;
+    // 同一个inode只有一个watch 硬链接等情况下可能对应多个路径
+    std::unordered_map<int, std::vector<std::string>> watches_;
+    size_t memoryBytes_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> invalidations_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<size_t> numEntries_;
+    std::atomic<size_t> statMemoryBytes_;
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+#include <Buffer.hpp>
+#include <Callbacks.hpp>
+#include <FileHandle.hpp>
+#include <InetAddress.hpp>
+#include <SharedSlice.hpp>
+#include <Timestamp.hpp>
+
+class Channel;
+class EventLoop;
+class Socket;
+
+/**
+ * 一个已建立的TCP连接 由TcpServer创建 属于某一个subloop 所有I/O都在这个loop线程中进行
+ *
+ * 生命周期:
+ * 连接由shared_ptr管理 TcpServer的连接表持有一份 channel通过tie持有weak_ptr
+ * 每次处理事件时先把weak_ptr提升为shared_ptr 连接在回调执行期间不会被析构 已析构的连接不会再收到回调
+ * 用户回调得到的是shared_ptr 可以保存下来在其他线程中send/shutdown
+ *
+ * 发送:
+ * 1. send可以在任意线程调用 不在loop线程时把数据拷贝一份交给loop线程
+ * 2. 输出队列为空时先直接write 内核发送缓冲区放得下就不经过输出队列 也不需要关注EPOLLOUT
+ * 3. 写不完的部分按块加入输出队列 关注EPOLLOUT 可写时用一次writev写出多个块 不把它们拼接到一起
+ * 4. 输出队列超过高水位时调用HighWaterMarkCallback 并(默认)暂停读这个连接
+ *    对端发来的请求不再被读取 它产生的响应也就不会继续堆积 降到低水位以下时调用LowWaterMarkCallback并恢复读
+ *    代理一类的场景可以在回调中对另一端的连接stopRead/startRead 把背压传给数据的来源
+ * 5. send(SharedSlice)不拷贝数据 输出队列只持有引用 同一条消息广播给大量连接时只占一份内存
+ *    块写完后在loop线程中释放引用
+ * 6. sendFile把文件作为一块加入输出队列 与内存中的块按调用顺序交替发送 文件数据不经过用户态
+ *    普通文件用sendfile 其他fd(管道、socket、字符设备)从源splice进连接自己的管道再splice到socket
+ *    socket缓冲区满时等EPOLLOUT继续 源暂时没有数据时改为关注源的可读事件 有数据后再继续
+ *    文件块不计入outputBytes 不触发高水位
+ **/
+class TcpConnection : public std::enable_shared_from_this<TcpConnection>
+{
+public:
+    static const size_t kDefaultHighWaterMark = 64 * 1024 * 1024;
+
+    TcpConnection(EventLoop *loop, const std::string &name, int sockfd,
+                  const InetAddress &localAddr, const InetAddress &peerAddr);
+    ~TcpConnection();
+
+    TcpConnection(const TcpConnection &) = delete;
+    TcpConnection &operator=(const TcpConnection &) = delete;
+
+    EventLoop *getLoop() const { return loop_; }
+    const std::string &name() const { return name_; }
+    const InetAddress &localAddress() const { return localAddr_; }
+    const InetAddress &peerAddress() const { return peerAddr_; }
+    bool connected() const { return state_ == kConnected; }
+    bool disconnected() const { return state_ == kDisconnected; }
+
+    // 发送数据 可以跨线程调用 连接没有建立或者已经在关闭时丢弃
+    void send(const void *data, size_t len);
+    void send(const std::string &message) { send(message.data(), message.size()); }
+    // 跨线程时直接移动到loop线程 不再拷贝
+    void send(std::string &&message);
+    // 发送buf中所有可读数据并清空buf
+    void send(Buffer *buf);
+    // 发送共享的只读数据 只增加引用计数 不拷贝 跨线程时同样只传递引用
+    void send(const SharedSlice &slice);
+    // 按顺序发送多段 比如每个连接自己的头加上共享的消息体 一次writev写出
+    void send(const std::vector<SharedSlice> &slices);
+    /**
+     * 发送fd从offset开始的len字节 可以跨线程调用
+     * 连接dup一份fd 调用后就可以关闭fd offset为-1时从fd的当前位置读(管道、socket只能这样)
+     * 数据不足len字节(文件被截断、源提前结束)时记录错误并关闭连接 因为对端已经无法按长度解析后面的数据
+     * 非普通文件的源在没有数据时会注册到这个loop上等待可读 所以不能是已经注册在这个loop上的fd
+     */
+    void sendFile(int fd, off_t offset, size_t len);
+    // 发送期间共享file 比如文件缓存中打开的fd 不需要dup
+    void sendFile(const FileHandlePtr &file, off_t offset, size_t len);
+
+    // 输出队列写完之后关闭写端 对端读到0后关闭连接
+    void shutdown();
+    // 不等输出队列写完 直接关闭连接
+    void forceClose();
+    void setTcpNoDelay(bool on);
+
+    // 恢复/暂停读这个连接 可以跨线程调用 暂停时对端发来的数据留在内核接收缓冲区中 对端最终会被TCP流控阻塞
+    // 对端半关闭(HalfCloseCallback)之后已经没有数据可读 startRead不再生效
+    void startRead();
+    void stopRead();
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
+    {
+        highWaterMarkCallback_ = cb;
+        highWaterMark_ = highWaterMark;
+    }
+    // 越过高水位之后输出队列降到lowWaterMark字节及以下时调用 默认为0 即写完时
+    void setLowWaterMarkCallback(const LowWaterMarkCallback &cb, size_t lowWaterMark)
+    {
+        lowWaterMarkCallback_ = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
+    // 超过高水位时是否自动暂停读 默认为true
+    void setPauseReadingOnHighWaterMark(bool on) { pauseReadingOnHighWaterMark_ = on; }
+    // 对端关闭写端(shutdown)后调用 此时已经读完对端发来的所有数据 连接仍然可以发送 发送完毕后由用户shutdown
+    // 本端写端关闭后连接随即关闭 对端半关闭时本端已经shutdown过的 不再调用回调 输出队列照常写完
+    // 不设置时按连接关闭处理 未发送的数据被丢弃
+    void setHalfCloseCallback(const HalfCloseCallback &cb) { halfCloseCallback_ = cb; }
+    // TcpServer用来把连接从连接表中移除
+    void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+
+    // 输出队列中还没有写出的内存数据字节数(不含文件块) 只能在loop线程中调用
+    size_t outputBytes() const { return outputBytes_; }
+    Buffer *inputBuffer() { return &inputBuffer_; }
+
+    // TcpServer在连接分配到loop之后/从连接表移除之后在loop线程中调用
+    void connectEstablished();
+    void connectDestroyed();
+
+private:
+    enum StateE
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected,
+        kDisconnecting,
+    };
+    void setState(StateE state) { state_ = state; }
+
+    void handleRead(Timestamp receiveTime);
+    void handleWrite();
+    void handleClose();
+    void handleError();
+    void handleHalfClose();
+
+    // 输出队列中的一块 自己持有的数据、共享slice的引用或者一段文件
+    struct OutputChunk
+    {
+        std::string owned;
+        SharedSlice slice;
+        FileHandlePtr file; // 不为空时是文件块 从fileOffset开始还要发送fileBytes字节
+        off_t fileOffset = 0;
+        size_t fileBytes = 0;
+
+        bool isFile() const { return file != nullptr; }
+        const char *data() const { return slice.empty() ? owned.data() : slice.data(); }
+        size_t size() const { return slice.empty() ? owned.size() : slice.size(); }
+    };
+
+    // 输出队列为空时先直接写 剩下的部分加入输出队列 message不为空时剩余部分直接移动进队列
+    void sendInLoop(const char *data, size_t len, std::string *message = nullptr);
+    void sendSlicesInLoop(const SharedSlice *slices, size_t count);
+    // 把数据加入输出队列 和最后一块都很小时追加到最后一块后面 减少writev的段数
+    void appendOutput(const char *data, size_t len, std::string *message);
+    void appendOutput(SharedSlice slice);
+    // 数据加入输出队列之后调用 检查高水位并关注EPOLLOUT
+    void outputQueued();
+    // 输出队列为空时直接写出的部分 返回写出的字节数 连接已经不可用时返回-1
+    ssize_t writeDirect(const struct iovec *iov, int count, size_t total);
+    void sendFileInLoop(const FileHandlePtr &file, off_t offset, size_t len);
+    // 写出输出队列 内存块用writev 队首是文件块时发送文件 返回false表示连接出错
+    bool writeOutput();
+    bool writeFile(OutputChunk &chunk);
+    bool spliceFile(OutputChunk &chunk);
+    // 文件块发送完毕 从队列中移除
+    void popFileChunk();
+    // splice的源暂时没有数据 停止关注socket可写 改为等源可读
+    void waitForSource(int fd);
+    void sourceReadable();
+    void removeSourceChannel();
+    void shutdownInLoop();
+    void forceCloseInLoop();
+    // 按用户意愿、背压状态和对端是否半关闭设置是否关注读事件
+    void updateReading();
+
+    EventLoop *loop_;
+    const std::string name_;
+    std::atomic<int> state_;
+    bool reading_;     // 用户希望读(startRead/stopRead)
+    bool readPaused_;  // 因为超过高水位暂停了读
+    bool overHighWaterMark_; // 越过高水位之后还没有降到低水位 高/低水位回调成对出现
+    bool waitingForSource_;  // splice的源没有数据 暂时不关注可写
+    bool peerHalfClosed_;    // 对端已经关闭写端(设置了HalfCloseCallback时) 本端写端关闭后即关闭连接
+
+    std::unique_ptr<Socket> socket_;
+    std::unique_ptr<Channel> channel_;
+    const InetAddress localAddr_;
+    const InetAddress peerAddr_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    HighWaterMarkCallback highWaterMarkCallback_;
+    LowWaterMarkCallback lowWaterMarkCallback_;
+    HalfCloseCallback halfCloseCallback_;
+    CloseCallback closeCallback_;
+    size_t highWaterMark_;
+    size_t lowWaterMark_;
+    bool pauseReadingOnHighWaterMark_;
+
+    Buffer inputBuffer_;
+    std::deque<OutputChunk> outputQueue_; // 还没有写出的数据块
+    size_t outputOffset_;                 // 第一块中已经写出的字节数
+    size_t outputBytes_;                  // 输出队列内存块中还没有写出的总字节数
+    int pipeFds_[2];                      // splice用的管道 第一次需要时创建
+    size_t pipeBytes_;                    // 已经进入管道还没有写到socket的字节数
+    std::unique_ptr<Channel> sourceChannel_; // 等待splice的源可读
+};
+
+// TcpServer的默认回调: 记录连接建立/断开 丢弃收到的数据
+void defaultConnectionCallback(const TcpConnectionPtr &conn);
+void defaultMessageCallback(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp receiveTime);
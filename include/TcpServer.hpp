@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <Callbacks.hpp>
+#include <EventLoopThreadPool.hpp>
+#include <InetAddress.hpp>
+
+class Acceptor;
+class EventLoop;
+
+/**
+ * TCP服务器 mainloop(构造时传入的loop)运行Acceptor 新连接按分配策略交给线程池中的subloop
+ * 连接表只在mainloop中访问 连接的I/O和用户回调都在它所属的subloop中执行
+ *
+ * 用法:
+ *   TcpServer server(&loop, InetAddress(8080), "echo");
+ *   server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+ *                             { conn->send(buf); });
+ *   server.setThreadNum(4);
+ *   server.start();
+ *   loop.loop();
+ **/
+class TcpServer
+{
+public:
+    using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+    enum Option
+    {
+        kNoReusePort,
+        kReusePort,
+    };
+
+    TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+              Option option = kNoReusePort);
+    ~TcpServer();
+
+    TcpServer(const TcpServer &) = delete;
+    TcpServer &operator=(const TcpServer &) = delete;
+
+    const std::string &ipPort() const { return ipPort_; }
+    const std::string &name() const { return name_; }
+    EventLoop *getLoop() const { return loop_; }
+
+    // 以下设置必须在start()之前调用
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy) { threadPool_->setDispatchPolicy(policy); }
+    void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    void setHalfCloseCallback(const HalfCloseCallback &cb) { halfCloseCallback_ = cb; }
+    // 每个连接的输出队列高/低水位 见TcpConnection
+    void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
+    {
+        highWaterMarkCallback_ = cb;
+        highWaterMark_ = highWaterMark;
+    }
+    void setLowWaterMarkCallback(const LowWaterMarkCallback &cb, size_t lowWaterMark)
+    {
+        lowWaterMarkCallback_ = cb;
+        lowWaterMark_ = lowWaterMark;
+    }
+
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
+
+    // 启动线程池并开始监听 可以多次调用 只有第一次生效 可以跨线程调用
+    void start();
+
+private:
+    // Acceptor接受新连接后在mainloop中调用
+    void newConnection(int sockfd, const InetAddress &peerAddr);
+    // 连接关闭时在subloop中调用 转到mainloop中移除
+    void removeConnection(const TcpConnectionPtr &conn);
+    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+
+    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+
+    EventLoop *loop_; // mainloop
+    const std::string ipPort_;
+    const std::string name_;
+    std::unique_ptr<Acceptor> acceptor_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    HalfCloseCallback halfCloseCallback_;
+    HighWaterMarkCallback highWaterMarkCallback_;
+    LowWaterMarkCallback lowWaterMarkCallback_;
+    size_t highWaterMark_;
+    size_t lowWaterMark_;
+    ThreadInitCallback threadInitCallback_;
+
+    std::atomic<int> started_;
+    int nextConnId_;          // 只在mainloop中访问
+    ConnectionMap connections_; // 所有连接 只在mainloop中访问
+};
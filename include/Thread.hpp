@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/types.h>
+
+// 对std::thread的封装 start()返回时线程已经启动 并且可以拿到线程的tid
+class Thread
+{
+public:
+    using ThreadFunc = std::function<void()>;
+
+    explicit Thread(ThreadFunc func, const std::string &name = std::string());
+    ~Thread();
+
+    Thread(const Thread &) = delete;
+    Thread &operator=(const Thread &) = delete;
+
+    // 启动线程 阻塞到新线程获取到自己的tid为止
+    void start();
+    void join();
+
+    bool started() const { return started_; }
+    pid_t tid() const { return tid_; }
+    const std::string &name() const { return name_; }
+
+    static int numCreated() { return numCreated_; }
+
+private:
+    void setDefaultName();
+
+    bool started_;                        // 是否已经启动
+    bool joined_;                         // 是否已经join
+    std::shared_ptr<std::thread> thread_; // 底层线程
+    pid_t tid_;                           // 线程启动后才能获取到
+    ThreadFunc func_;                     // 线程执行的函数
+    std::string name_;                    // 线程名 会同步设置到内核(top -H可见)
+    static std::atomic_int numCreated_;   // 已创建的线程数 用于生成默认线程名
+};
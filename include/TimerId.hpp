@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+class TimerQueue;
+
+/**
+ * 定时器的句柄 由EventLoop::runAt/runAfter/runEvery返回 用于EventLoop::cancel
+ * slot_为定时器在TimerQueue槽位表中的下标 sequence_为全局唯一的序号
+ * 槽位会被复用 所以取消时必须同时核对sequence_ 防止误删复用该槽位的新定时器
+ * 跨线程添加的定时器在入队时还没有槽位 slot_为-1 由TimerQueue按sequence_查找
+ **/
+class TimerId
+{
+public:
+    TimerId() : slot_(-1), sequence_(0) {}
+    TimerId(int slot, int64_t sequence) : slot_(slot), sequence_(sequence) {}
+
+    // sequence_从1开始分配 0表示无效的定时器
+    bool valid() const { return sequence_ != 0; }
+
+    friend class TimerQueue;
+
+private:
+    int slot_;
+    int64_t sequence_;
+};
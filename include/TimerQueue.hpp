@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <Channel.hpp>
+#include <InlineFunction.hpp>
+#include <TimerId.hpp>
+#include <Timestamp.hpp>
+
+class EventLoop;
+
+/**
+ * 定时器队列 每个EventLoop持有一个
+ * 1. 用一个timerfd(CLOCK_MONOTONIC)作为Channel注册到loop上 到期时走正常的读事件分发
+ *    系统时间被修改(ntp校时、手动改时间)不会导致定时器提前触发或者卡住
+ * 2. 定时器本体存放在扁平的槽位表timers_中 空闲槽位用freeSlots_复用 添加定时器不分配节点
+ * 3. 到期顺序由4叉小根堆heap_维护 堆元素只有16字节(到期时间+槽位+版本号)
+ *    一个节点的4个孩子正好占一条64字节的cache line 比std::set的红黑树节点访存友好得多
+ * 4. 取消定时器是O(1)的: 只释放槽位并递增版本号 堆中残留的元素在出堆时按版本号识别丢弃
+ *    残留元素超过堆大小的一半时整体重建堆 保证堆不会被大量已取消的超时定时器撑大
+ * 5. 一次timerfd可读事件中批量取出所有已到期的定时器依次执行
+ **/
+class TimerQueue
+{
+public:
+    using TimerCallback = InlineFunction<void()>;
+
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    // 在时间点when(系统时间)执行cb 内部换算成单调时钟上的到期时间 interval>0时周期执行
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // delay秒后执行cb interval>0时周期执行
+    TimerId addTimerAfter(TimerCallback cb, double delay, double interval);
+    // 取消定时器 对已到期的一次性定时器或重复取消都是安全的空操作
+    void cancel(TimerId timerId);
+
+    // 当前仍然有效的定时器个数
+    size_t size() const { return activeCount_; }
+
+    // CLOCK_MONOTONIC的当前时间 单位微秒
+    static int64_t monotonicMicroseconds();
+
+private:
+    // 槽位表中的定时器
+    struct Timer
+    {
+        TimerCallback callback; // 定时器回调
+        int64_t interval;       // 重复间隔(微秒) 0表示一次性定时器
+        int64_t sequence;       // 全局序号 与TimerId中的sequence_对应 0表示槽位空闲
+        uint32_t generation;    // 槽位版本号 每次释放槽位时递增 用于识别堆中的残留元素
+        bool armed;             // 是否在堆中(到期取出执行时为false)
+        bool foreign;           // 是否由其他线程添加(需要在foreignTimers_中登记)
+    };
+
+    // 堆元素 16字节
+    struct HeapEntry
+    {
+        int64_t expiration; // 单调时钟上的到期时间(微秒)
+        uint32_t slot;      // 定时器所在的槽位
+        uint32_t generation; // 入堆时槽位的版本号
+    };
+
+    static const int kArity = 4;                 // 堆的叉数
+    static const size_t kCompactThreshold = 1024; // 残留元素达到该值才考虑重建堆
+
+    void handleRead(); // timerfd可读 处理到期的定时器
+
+    int insertInLoop(TimerCallback cb, int64_t expiration, int64_t interval,
+                     int64_t sequence, bool foreign);
+    void cancelInLoop(TimerId timerId);
+    void releaseSlot(uint32_t slot);
+
+    // 堆中元素是否已经失效(对应的定时器被取消或槽位被复用)
+    bool isStale(const HeapEntry &entry) const
+    {
+        return timers_[entry.slot].generation != entry.generation;
+    }
+    void pushHeap(const HeapEntry &entry);
+    void popHeap();
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void compactHeap(); // 丢弃所有残留元素后重建堆
+
+    // 让timerfd在expiration时刻触发
+    void resetTimerfd(int64_t expiration);
+    // 按堆顶重新设置timerfd 堆顶的残留元素会先被弹出
+    void rearm();
+
+    EventLoop *loop_;        // 定时器队列所属的EventLoop
+    const int timerfd_;      // timerfd_create创建的文件描述符
+    Channel timerfdChannel_; // 封装timerfd_的channel
+    int64_t armedExpiration_; // timerfd当前设置的到期时间 用于省掉不必要的timerfd_settime
+
+    std::vector<Timer> timers_;       // 定时器槽位表
+    std::vector<uint32_t> freeSlots_; // 空闲槽位
+    std::vector<HeapEntry> heap_;     // 4叉小根堆
+    std::vector<HeapEntry> expired_;  // 本轮到期的定时器 复用以避免每次分配
+    size_t activeCount_;              // 有效定时器个数
+    size_t staleEntries_;             // 堆中残留的无效元素个数
+    bool callingExpiredTimers_;       // 是否正在执行到期定时器的回调
+
+    // 其他线程添加的定时器: sequence => slot
+    std::unordered_map<int64_t, uint32_t> foreignTimers_;
+
+    static std::atomic<int64_t> s_numCreated_; // 用于生成全局唯一的sequence
+};
@@ -2,6 +2,7 @@
 #define _TIMESTAMP_HPP
 
 #include <string>
+#include <ctime>
 #include <sys/time.h>
 
 class Timestamp
@@ -17,6 +18,12 @@ public:
 
     // 格式
     std::string toFormattedString(bool showMicroseconds = false) const;
+    /**
+     * 按toFormattedString的格式写入buf(至少kFormattedSize字节) 不写'\0' 返回写入的长度
+     * 每个线程缓存上一次的日期字符串 同一秒内不再调用localtime_r 只查表填写微秒
+     * 日志头部和日志文件名都用它
+     */
+    size_t formatTo(char *buf, bool showMicroseconds) const;
     // 返回当前时间戳的微秒数
     int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
     // 返回当前时间戳的秒数
@@ -29,6 +36,7 @@ public:
     static Timestamp invalid() { return Timestamp(); }
 
     static const int kMicroSecondsPerSecond = 1000 * 1000; // 1秒=1000*1000微妙
+    static const size_t kFormattedSize = 26;               // "2025/08/26 16:29:10.773804"
 
 private:
     int64_t
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <Timestamp.hpp>
+
+/**
+ * 哈希时间轮 用于连接空闲/keepalive这类粗粒度的超时 每个EventLoop持有一个
+ * 与TimerQueue的区别:
+ * 1. 精度只到一个tick(默认1秒) 换来的是添加/删除/刷新全部O(1)
+ *    超时时长是下限: 向上取整为tick数后再加一个tick(当前tick已经过去了一部分) 实际在timeout之后两个tick之内超时
+ * 2. Entry由使用者(连接对象)内嵌持有 侵入式双向链表挂在槽上 不做任何内存分配
+ * 3. touch()只更新一个整数形式的截止tick 不移动链表节点
+ *    槽被转到时发现截止时间已被推后 再把节点挂到新的槽上(惰性重排)
+ *    因此连接每次读到数据都刷新超时 成本也只是一次赋值
+ * 4. 不使用自己的定时器fd 由EventLoop在每次poll返回后用pollReturnTime_更新当前tick(updateTime)
+ *    处理完读写事件之后再推进(advance) 截止tick总是从本轮poll返回的时间算起
+ *    poll可能阻塞很久 不先更新当前tick的话 回调中加入/touch的Entry会得到已经过去的截止tick而被立即超时
+ *
+ * 注意: 所有操作必须在EventLoop所在线程中调用
+ **/
+class TimingWheel
+{
+public:
+    using ExpireCallback = std::function<void()>;
+
+    // 侵入式双向循环链表节点 槽的哨兵和Entry共用
+    struct Node
+    {
+        Node() : prev_(this), next_(this) {}
+        bool linked() const { return next_ != this; }
+
+        Node *prev_;
+        Node *next_;
+    };
+
+    // 内嵌在连接对象中的超时项
+    class Entry : private Node
+    {
+    public:
+        Entry() : wheel_(nullptr), deadline_(0), timeoutTicks_(0) {}
+        explicit Entry(ExpireCallback cb)
+            : wheel_(nullptr), deadline_(0), timeoutTicks_(0), callback_(std::move(cb)) {}
+        ~Entry();
+
+        Entry(const Entry &) = delete;
+        Entry &operator=(const Entry &) = delete;
+
+        // 超时后执行的回调 一般是关闭连接
+        void setCallback(ExpireCallback cb) { callback_ = std::move(cb); }
+
+        // 刷新截止时间为 当前tick + 超时时长 未加入时间轮时什么也不做
+        inline void touch();
+
+        // 是否已经加入时间轮
+        bool active() const { return wheel_ != nullptr; }
+
+    private:
+        friend class TimingWheel;
+
+        TimingWheel *wheel_;   // 所在的时间轮 为空表示未加入
+        int64_t deadline_;     // 截止tick 当前tick>=deadline_时超时
+        int64_t timeoutTicks_; // 超时时长(tick数)
+        ExpireCallback callback_;
+    };
+
+    /**
+     * @param tickMs 一个tick的毫秒数
+     * @param slots 槽的个数 会向上取整为2的幂
+     */
+    explicit TimingWheel(int tickMs = 1000, int slots = 512);
+    ~TimingWheel();
+
+    // 加入时间轮 timeout秒后超时 已经加入的会按新的超时时长重新计时
+    void add(Entry *entry, double timeout);
+    // 从时间轮中移除 未加入时是空操作
+    void remove(Entry *entry);
+
+    // 把当前tick更新到now 之后add/touch的截止tick从now算起 不处理超时 时间回拨时保持不动
+    void updateTime(Timestamp now);
+    // 更新到now并执行所有已超时的Entry的回调 超时的Entry会先被移出时间轮
+    void advance(Timestamp now);
+
+    int tickMs() const { return static_cast<int>(tickUs_ / 1000); }
+    int64_t currentTick() const { return currentTick_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    void link(Entry *entry); // 挂到截止tick对应的槽上
+    static void unlink(Node *node);
+    void expireSlot(size_t index); // 处理一个槽
+
+    const int64_t tickUs_;    // 一个tick的微秒数
+    std::vector<Node> slots_; // 每个槽是一个链表的哨兵
+    const size_t mask_;       // slots_.size() - 1
+    int64_t currentTick_;     // 当前tick 用于计算截止tick
+    int64_t expiredTick_;     // 已经处理过超时的最后一个tick 不超过currentTick_
+    size_t size_;             // 时间轮中的Entry个数
+};
+
+inline void TimingWheel::Entry::touch()
+{
+    if (wheel_)
+    {
+        deadline_ = wheel_->currentTick_ + timeoutTicks_;
+    }
+}
@@ -1,96 +1,572 @@
 #include <AsynLogging.hpp>
+#include <BinaryLog.hpp>
+#include <CurrentThread.hpp>
+#include <LogFile.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <string.h>
+#include <thread>
+
+namespace
+{
+    std::atomic<uint64_t> s_nextId(1); // AsynLogging对象的id 从1开始 0表示线程还没有缓冲区
+}
+
+thread_local AsynLogging::ThreadBufferCache AsynLogging::t_threadBuffer_;
 
 AsynLogging::AsynLogging(const std::string &basename, off_t rollSize,
-                         int flushInterval)
-    : basename_(basename), rollSize_(rollSize);
-flushInterval_(flushInterval), running_(false),
-    thread_(std::bind(&AsynLogging::threadFunc, this), "Logging"), mutex_(),
-    cond_(), currentBuffer_(new LargeBuffer), nextBuffer_(new LargeBuffer),
-    buffers_()
-{
-    currentBuffer->bzero();
-    nextBuffer->bzero();
+                         int flushInterval, size_t threadBufferSize)
+    : flushInterval_(flushInterval), running_(false), basename_(basename),
+      rollSize_(rollSize), threadBufferSize_(threadBufferSize),
+      id_(s_nextId.fetch_add(1, std::memory_order_relaxed)),
+      thread_(std::bind(&AsynLogging::threadFunc, this), "Logging"), mutex_(),
+      cond_(), wakeupRequested_(false), buffers_(), freeBuffers_(), numBuffers_(0),
+      poolSize_(0), maxBuffers_(0), crashSafe_(false), nextBufferFile_(0), indexInterval_(0), numFree_(0), policy_(kBlock), sampleEvery_(16),
+      unbufferedDrops_(0), droppedMessages_(0), drainRounds_(0),
+      binaryOutput_(false), headerFile_(-1), batchMinTime_(INT64_MAX), batchMaxTime_(INT64_MIN),
+      blockBytes_(0)
+{
     buffers_.reserve(16);
 }
 
-// 调用此函数解决前端把LOG_XXX<<"..."传递给后端，后端再将日志消息写入日志文件
-void AsynLogging::append(const char *logline, int len)
+AsynLogging::ThreadBuffer *AsynLogging::threadBuffer()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    // 缓冲区剩余的空间足够写入
-    if (currentBuffer_->avail() > len)
+    ThreadBufferCache &cache = t_threadBuffer_;
+    if (cache.owner == id_)
     {
-        currentBuffer_->append(logline, len);
+        // 之前因为达到上限没有拿到缓冲区 池中有空闲时再去取
+        if (cache.buffer || numFree_.load(std::memory_order_relaxed) == 0)
+        {
+            return cache.buffer.get();
+        }
     }
-    else
+    else if (cache.buffer)
     {
-        buffers_.push_bakc(std::move(currentBuffer_));
-        if (nextBuffer_)
+        // 之前写的是另一个AsynLogging对象
+        cache.buffer->closed.store(true, std::memory_order_release);
+        cache.buffer.reset();
+    }
+    cache.owner = id_;
+    cache.buffer = acquireBuffer();
+    return cache.buffer.get();
+}
+
+AsynLogging::ThreadBufferPtr AsynLogging::acquireBuffer()
+{
+    ThreadBufferPtr buffer;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!freeBuffers_.empty())
+        {
+            buffer = std::move(freeBuffers_.back());
+            freeBuffers_.pop_back();
+            numFree_.store(freeBuffers_.size(), std::memory_order_relaxed);
+        }
+        else if (maxBuffers_ != 0 && numBuffers_ >= maxBuffers_)
         {
-            currentBuffer_ = std::move(nextBuffer_);
+            return nullptr;
         }
         else
         {
-            currentBuffer_.reset(new LargeBuffer);
+            ++numBuffers_;
+            path = nextBufferPath();
         }
-        currentBuffer_->append(logline, len);
-        // 唤醒后端线程写入磁盘
-        cond_.notify_one();
     }
+    if (!buffer)
+    {
+        // 分配和预先缺页不持有锁
+        buffer = std::make_shared<ThreadBuffer>(threadBufferSize_, path);
+    }
+    buffer->closed.store(false, std::memory_order_relaxed);
+    buffer->wakeupSent.store(false, std::memory_order_relaxed);
+    buffer->tid = CurrentThread::tid();
+    buffer->lastUsed = 0;
+    buffer->sampleCount = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(buffer);
+    return buffer;
 }
 
-void AsynLogging::threadFunc()
+void AsynLogging::preallocateBuffers()
 {
-    // output写入磁盘接口
-    LogFile output(basename_, rollSize_);
-    BufferPtr newBuffer1(new LargeBuffer); // 生成新buffer替换currentbuffer_
-    BufferPtr newBuffer2(
-        new LargeBuffer); // 生成新buffer2替换newBuffer_，其目的是为了防止后端缓冲区全满前端无法写入
-    newBuffer1->bzero();
-    newBUffer2->bzero();
-    // 缓冲区数组置为16个，用于和前端缓冲区数组进行交换
-    BufferVector buffersToWrite;
-    buffersToWrite.reserve(16);
-    while (running_)
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (freeBuffers_.size() < poolSize_ && (maxBuffers_ == 0 || numBuffers_ < maxBuffers_))
+    {
+        freeBuffers_.push_back(std::make_shared<ThreadBuffer>(threadBufferSize_, nextBufferPath()));
+        ++numBuffers_;
+    }
+    numFree_.store(freeBuffers_.size(), std::memory_order_relaxed);
+}
+
+std::string AsynLogging::nextBufferPath()
+{
+    if (!crashSafe_)
+    {
+        return std::string();
+    }
+    return basename_ + ".ring." + std::to_string(nextBufferFile_++);
+}
+
+void AsynLogging::recoverBuffers()
+{
+    // 映射文件和日志文件在同一个目录下 名为basename.ring.N
+    std::string dir = ".";
+    std::string prefix = basename_;
+    size_t slash = basename_.rfind('/');
+    if (slash != std::string::npos)
+    {
+        dir = slash == 0 ? "/" : basename_.substr(0, slash);
+        prefix = basename_.substr(slash + 1);
+    }
+    prefix += ".ring.";
+    DIR *d = ::opendir(dir.c_str());
+    if (d == nullptr)
     {
+        return;
+    }
+    std::vector<std::string> paths;
+    while (struct dirent *entry = ::readdir(d))
+    {
+        if (::strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0)
         {
-            // 互斥锁保护这样就保证了其他前端线程无法向前端buffer写入数据
-            std::unique_lock<std::mutex> lg(mutex_);
-            if (buffers_.empty())
-            {
-                cond_.wait(lg, std::chrono::seconds(3));
-            }
-            buffers_.push_back(std::move(currentBuffer_));
-            currentBuffer_ = std::move(newBuffer1);
-            if (!nextBuffer_)
-            {
-                nextBuffer_ = std::move(newBuffer2);
-            }
-            buffersToWrite.swap(buffers_);
+            paths.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    ::closedir(d);
+    std::sort(paths.begin(), paths.end());
+
+    for (const std::string &path : paths)
+    {
+        size_t binaryRecords = 0;
+        long count = SpscRing::recover(path, [this, &binaryRecords](const char *data, size_t len, uint32_t kind)
+                                       {
+                                           if (kind == BinaryLog::kTextRecord)
+                                           {
+                                               recovered_.append(data, len);
+                                           }
+                                           else
+                                           {
+                                               ++binaryRecords;
+                                           }
+                                       });
+        if (count > 0)
+        {
+            char line[512];
+            size_t len = Timestamp::now().formatTo(line, true);
+            len += ::snprintf(line + len, sizeof(line) - len,
+                              " %5d WARN  recovered %ld log records from %s left by the previous run"
+                              " (%zu binary records skipped) - AsynLogging.cpp:%d\n",
+                              CurrentThread::tid(), count, path.c_str(), binaryRecords, __LINE__);
+            recovered_.append(line, std::min(len, sizeof(line) - 1));
+        }
+        ::unlink(path.c_str());
+    }
+}
+
+char *AsynLogging::discard(ThreadBuffer *buffer, size_t len)
+{
+    if (buffer)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        // 让后端尽快腾出空间
+        if (!buffer->wakeupSent.exchange(true, std::memory_order_acq_rel))
+        {
+            wakeupBackend();
+        }
+    }
+    else
+    {
+        unbufferedDrops_.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::vector<char> &storage = t_threadBuffer_.discard;
+    if (storage.size() < len)
+    {
+        storage.resize(len > kSmallBufferSize ? len : kSmallBufferSize);
+    }
+    return storage.data();
+}
+
+char *AsynLogging::reserve(size_t len)
+{
+    // 后端线程自己打的日志不能进缓冲区 缓冲区满时会等待自己 退回到Logger的OutputFunc
+    if (!running_.load(std::memory_order_relaxed) || CurrentThread::tid() == thread_.tid())
+    {
+        return nullptr;
+    }
+    ThreadBuffer *buffer = threadBuffer();
+    if (buffer == nullptr)
+    {
+        // 缓冲区总数达到上限
+        return discard(nullptr, len);
+    }
+    if (len + SpscRing::kHeaderSize > buffer->ring.capacity())
+    {
+        return nullptr;
+    }
+    int policy = policy_.load(std::memory_order_relaxed);
+    if (policy == kSample && buffer->lastUsed > buffer->ring.capacity() / 4 * 3 &&
+        ++buffer->sampleCount % static_cast<unsigned>(sampleEvery_.load(std::memory_order_relaxed)) != 0)
+    {
+        return discard(buffer, len);
+    }
+    char *data = buffer->ring.reserve(len);
+    if (data == nullptr && policy != kBlock)
+    {
+        return discard(buffer, len);
+    }
+    while (data == nullptr)
+    {
+        // 缓冲区满 唤醒后端并等待它取走日志 不丢日志
+        wakeupBackend();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        if (!running_.load(std::memory_order_relaxed))
+        {
+            return nullptr;
         }
-        // 从待写缓冲区取出数据通过LogFile提供的接口写入到磁盘中
-        for (auto &buffer : buffersToWrite)
+        data = buffer->ring.reserve(len);
+    }
+    return data;
+}
+
+void AsynLogging::commit(const char *data, size_t len, uint32_t kind)
+{
+    ThreadBufferCache &cache = t_threadBuffer_;
+    if (!cache.discard.empty() && data == cache.discard.data())
+    {
+        return; // 被丢弃的日志
+    }
+    ThreadBuffer *buffer = cache.buffer.get();
+    size_t used = buffer->ring.commit(len, kind);
+    buffer->lastUsed = used;
+    // 超过一半时唤醒后端 每次取走之前只唤醒一次
+    if (used > buffer->ring.capacity() / 2 &&
+        !buffer->wakeupSent.exchange(true, std::memory_order_acq_rel))
+    {
+        wakeupBackend();
+    }
+}
+
+// 调用此函数解决前端把LOG_XXX<<"..."传递给后端，后端再将日志消息写入日志文件
+void AsynLogging::append(const char *logline, int len)
+{
+    char *data = reserve(static_cast<size_t>(len));
+    if (data)
+    {
+        ::memcpy(data, logline, len);
+        commit(data, static_cast<size_t>(len));
+    }
+}
+
+void AsynLogging::flush()
+{
+    if (!running_.load(std::memory_order_relaxed) || CurrentThread::tid() == thread_.tid())
+    {
+        return;
+    }
+    // 正在进行的一轮可能没有看到刚提交的日志 等待之后完整的一轮结束
+    uint64_t target = drainRounds_.load(std::memory_order_acquire) + 2;
+    for (int i = 0; i < 1000 && drainRounds_.load(std::memory_order_acquire) < target; ++i)
+    {
+        wakeupBackend();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void AsynLogging::wakeupBackend()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeupRequested_ = true;
+    cond_.notify_one();
+}
+
+size_t AsynLogging::drainBuffers(const std::vector<ThreadBufferPtr> &buffers, LogFile &output)
+{
+    // 先收集所有缓冲区的记录 写完之后再释放 记录的内存在写出之前保持有效
+    size_t count = 0;
+    drainEnds_.clear();
+    for (const ThreadBufferPtr &buffer : buffers)
+    {
+        drainEnds_.push_back(buffer->ring.peek([this, &output](char *data, size_t len, uint32_t kind)
+                                               { writeRecord(output, data, len, kind); },
+                                               &count));
+        uint64_t dropped = buffer->dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped)
         {
-            output.append(buffer->data(), buffer->length());
+            queueDropMarker(output, dropped, buffer->tid);
         }
-        if (buffersToWrite.size() > 2)
+    }
+    uint64_t dropped = unbufferedDrops_.exchange(0, std::memory_order_relaxed);
+    if (dropped)
+    {
+        queueDropMarker(output, dropped, 0);
+    }
+    writeBatch(output);
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        buffers[i]->ring.release(drainEnds_[i]);
+        buffers[i]->wakeupSent.store(false, std::memory_order_release);
+    }
+    return count;
+}
+
+void AsynLogging::writeRecord(LogFile &output, char *data, size_t len, uint32_t kind)
+{
+    bool binaryRecord = kind == BinaryLog::kBinaryRecord && len >= sizeof(BinaryLog::RecordHeader);
+    BinaryLog::RecordHeader header;
+    if (binaryRecord)
+    {
+        ::memcpy(&header, data, sizeof(header));
+        header.timestamp = clock_.toMicroseconds(header.timestamp);
+        ::memcpy(data, &header, sizeof(header));
+        noteTime(header.timestamp);
+    }
+    if (binaryOutput_)
+    {
+        prepareBinaryFile(output, binaryRecord ? header.siteId : 0);
+        // 缓冲区中的记录头和文件中的记录头格式相同 连同记录头一起写入
+        queueOutput(data - SpscRing::kHeaderSize, len + SpscRing::kHeaderSize);
+    }
+    else if (binaryRecord)
+    {
+        // 延迟到后端线程格式化
+        size_t old = scratch_.size();
+        BinaryLog::formatRecord(BinaryLog::findSite(header.siteId), header,
+                                data + sizeof(header), len - sizeof(header), scratch_);
+        queueScratch(scratch_.size() - old);
+    }
+    else
+    {
+        noteTextTime(data, len);
+        queueOutput(data, len);
+    }
+    cutIndexBlock();
+}
+
+void AsynLogging::noteTextTime(const char *data, size_t len)
+{
+    int64_t micros = 0;
+    if (indexInterval_ > 0 && timeParser_.parse(data, len, &micros))
+    {
+        noteTime(micros);
+    }
+}
+
+void AsynLogging::prepareBinaryFile(LogFile &output, uint32_t siteId)
+{
+    // 一轮的数据整批写入同一个文件 滚动只发生在两轮之间
+    int file = output.fileCount();
+    if (headerFile_ != file)
+    {
+        headerFile_ = file;
+        uint32_t header[2] = {static_cast<uint32_t>(sizeof(BinaryLog::kFileMagic)),
+                              BinaryLog::kMagicRecord};
+        scratch_.append(reinterpret_cast<const char *>(header), sizeof(header));
+        scratch_.append(BinaryLog::kFileMagic, sizeof(BinaryLog::kFileMagic));
+        queueScratch(sizeof(header) + sizeof(BinaryLog::kFileMagic));
+    }
+    const BinaryLogSite *site = BinaryLog::findSite(siteId);
+    if (site == nullptr)
+    {
+        return;
+    }
+    if (siteFiles_.size() <= siteId)
+    {
+        siteFiles_.resize(siteId + 1, -1);
+    }
+    if (siteFiles_[siteId] == file)
+    {
+        return;
+    }
+    siteFiles_[siteId] = file;
+    // 调用点定义: id 等级 行号 文件名\0 格式串\0 参数类型\0
+    int32_t fields[3] = {static_cast<int32_t>(siteId), static_cast<int32_t>(site->level), site->line};
+    size_t len = sizeof(fields) + strlen(site->file) + 1 + strlen(site->format) + 1 +
+                 strlen(site->argTypes) + 1;
+    uint32_t header[2] = {static_cast<uint32_t>(len), BinaryLog::kSiteRecord};
+    scratch_.append(reinterpret_cast<const char *>(header), sizeof(header));
+    scratch_.append(reinterpret_cast<const char *>(fields), sizeof(fields));
+    scratch_.append(site->file, strlen(site->file) + 1);
+    scratch_.append(site->format, strlen(site->format) + 1);
+    scratch_.append(site->argTypes, strlen(site->argTypes) + 1);
+    queueScratch(sizeof(header) + len);
+}
+
+void AsynLogging::queueDropMarker(LogFile &output, uint64_t dropped, int tid)
+{
+    droppedMessages_.fetch_add(dropped, std::memory_order_relaxed);
+    char line[256];
+    size_t len = Timestamp::now().formatTo(line, true);
+    len += ::snprintf(line + len, sizeof(line) - len,
+                      " %5d WARN  dropped %llu log messages%s - AsynLogging.cpp:%d\n",
+                      tid, static_cast<unsigned long long>(dropped),
+                      tid ? "" : " from threads without a buffer (buffer limit reached)", __LINE__);
+    queueText(output, line, len);
+}
+
+void AsynLogging::queueText(LogFile &output, const char *data, size_t len)
+{
+    if (binaryOutput_)
+    {
+        prepareBinaryFile(output, 0);
+        uint32_t header[2] = {static_cast<uint32_t>(len), BinaryLog::kTextRecord};
+        scratch_.append(reinterpret_cast<const char *>(header), sizeof(header));
+        queueScratch(sizeof(header));
+    }
+    // 可能是上次运行留下的多行日志 每行的时间都要计入
+    for (const char *line = data, *end = data + len; line < end;)
+    {
+        const char *eol = static_cast<const char *>(::memchr(line, '\n', end - line));
+        eol = eol ? eol + 1 : end;
+        noteTextTime(line, eol - line);
+        line = eol;
+    }
+    scratch_.append(data, len);
+    queueScratch(len);
+    cutIndexBlock();
+}
+
+void AsynLogging::cutIndexBlock()
+{
+    if (indexInterval_ > 0 && blockBytes_ >= static_cast<size_t>(indexInterval_))
+    {
+        indexBlocks_.push_back({iov_.size(), batchMinTime_, batchMaxTime_});
+        batchMinTime_ = INT64_MAX;
+        batchMaxTime_ = INT64_MIN;
+        blockBytes_ = 0;
+    }
+}
+
+void AsynLogging::queueOutput(const char *data, size_t len)
+{
+    blockBytes_ += len;
+    // 不与上一个索引块的最后一段合并
+    bool merge = indexBlocks_.empty() || indexBlocks_.back().iovEnd < iov_.size();
+    if (merge && !iov_.empty() && iov_.back().iov_base != nullptr &&
+        static_cast<char *>(iov_.back().iov_base) + iov_.back().iov_len == data)
+    {
+        iov_.back().iov_len += len;
+        return;
+    }
+    iov_.push_back({const_cast<char *>(data), len});
+}
+
+void AsynLogging::queueScratch(size_t len)
+{
+    // scratch_在本轮中可能重新分配 写出前才确定地址
+    blockBytes_ += len;
+    bool merge = indexBlocks_.empty() || indexBlocks_.back().iovEnd < iov_.size();
+    if (merge && !iov_.empty() && iov_.back().iov_base == nullptr)
+    {
+        iov_.back().iov_len += len;
+        return;
+    }
+    iov_.push_back({nullptr, len});
+}
+
+void AsynLogging::writeBatch(LogFile &output)
+{
+    if (iov_.empty())
+    {
+        return;
+    }
+    size_t offset = 0;
+    for (struct iovec &iov : iov_)
+    {
+        if (iov.iov_base == nullptr)
         {
-            buffersToWrite.resize(2);
+            iov.iov_base = &scratch_[offset];
+            offset += iov.iov_len;
         }
-        if (!newBuffer1)
+    }
+    // 每个索引块单独写入 LogFile为每块记一条索引
+    if (indexBlocks_.empty() || indexBlocks_.back().iovEnd < iov_.size())
+    {
+        indexBlocks_.push_back({iov_.size(), batchMinTime_, batchMaxTime_});
+    }
+    size_t begin = 0;
+    for (const IndexBlock &block : indexBlocks_)
+    {
+        output.appendv(&iov_[begin], static_cast<int>(block.iovEnd - begin), block.minTime, block.maxTime);
+        begin = block.iovEnd;
+    }
+    iov_.clear();
+    scratch_.clear();
+    indexBlocks_.clear();
+    batchMinTime_ = INT64_MAX;
+    batchMaxTime_ = INT64_MIN;
+    blockBytes_ = 0;
+}
+
+void AsynLogging::threadFunc()
+{
+    // output写入磁盘接口
+    LogFile output(basename_, rollSize_, flushInterval_);
+    output.setCompressor(compressor_.get());
+    if (binaryOutput_)
+    {
+        indexInterval_ = 0; // 二进制日志文件不生成时间索引 一轮的数据也不切分
+    }
+    output.setIndexInterval(indexInterval_);
+    std::vector<ThreadBufferPtr> buffers; // 本轮要处理的缓冲区 复用以避免每次分配
+    if (!recovered_.empty())
+    {
+        // 上次运行崩溃时留下的日志
+        queueText(output, recovered_.data(), recovered_.size());
+        writeBatch(output);
+        std::string().swap(recovered_);
+    }
+    while (running_)
+    {
         {
-            newBuffer1 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer1->reset();
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!wakeupRequested_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            wakeupRequested_ = false;
+            buffers.assign(buffers_.begin(), buffers_.end());
         }
-        if (!newBuffer2)
+        // 不持有锁 前端线程写日志不受影响
+        clock_.recalibrate();
+        drainBuffers(buffers, output);
+        output.flush();
+        drainRounds_.fetch_add(1, std::memory_order_release);
+        buffers.clear();
+
+        // 回收已退出线程的缓冲区 closed之后不会再有新日志 此时为空说明已经全部写出
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t kept = 0;
+        for (size_t i = 0; i < buffers_.size(); ++i)
         {
-            newBuffer2 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer2->reset();
+            ThreadBufferPtr &buffer = buffers_[i];
+            if (!buffer->closed.load(std::memory_order_acquire) || !buffer->ring.empty())
+            {
+                if (kept != i)
+                {
+                    buffers_[kept] = std::move(buffer);
+                }
+                ++kept;
+            }
+            else if (freeBuffers_.size() < poolSize_)
+            {
+                freeBuffers_.push_back(std::move(buffer));
+            }
+            else
+            {
+                --numBuffers_;
+            }
         }
-        buffersToWrite.clear(); // 清空后端缓冲队列
-        output.flush();         // 清空文件夹缓冲区
+        buffers_.resize(kept);
+        numFree_.store(freeBuffers_.size(), std::memory_order_relaxed);
     }
+    // 退出前写出剩余的日志
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers.assign(buffers_.begin(), buffers_.end());
+    }
+    drainBuffers(buffers, output);
     output.flush(); // 确保清空文件夹缓冲区
-}
\ No newline at end of file
+}
@@ -0,0 +1,442 @@
+#include <BinaryLog.hpp>
+
+#include <ctype.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#include <mutex>
+#include <stdio.h>
+
+extern const char *getLevelName[Logger::LogLevel::LEVEL_COUNT];
+extern Logger::OutputFunc g_output;
+
+namespace
+{
+    // CPUID 0x80000007 EDX bit 8: 不变TSC(频率恒定 深度睡眠也不停)
+    bool detectInvariantTsc()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+        {
+            return (edx & (1u << 8)) != 0;
+        }
+#endif
+        return false;
+    }
+
+    std::mutex g_siteMutex;
+    uint32_t g_numSites = 0;                                        // 已登记的调用点个数 由g_siteMutex保护
+    std::atomic<const BinaryLogSite *> g_sites[BinaryLog::kMaxSites + 1]; // id => 调用点 id从1开始
+
+    // 一个解码出来的参数
+    struct Arg
+    {
+        char type;
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char *s;
+        size_t slen;
+    };
+
+    // 按类型码从args中取出一个参数 字节不够时返回false
+    bool decodeArg(char type, const char *&args, const char *end, Arg &arg)
+    {
+        arg.type = type;
+        arg.i = 0;
+        arg.u = 0;
+        arg.d = 0;
+        arg.s = nullptr;
+        arg.slen = 0;
+        auto take = [&args, end](void *dst, size_t n)
+        {
+            if (static_cast<size_t>(end - args) < n)
+            {
+                return false;
+            }
+            ::memcpy(dst, args, n);
+            args += n;
+            return true;
+        };
+        switch (type)
+        {
+        case BinaryLog::kInt8:
+        {
+            int8_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.i = v;
+            break;
+        }
+        case BinaryLog::kInt16:
+        {
+            int16_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.i = v;
+            break;
+        }
+        case BinaryLog::kInt32:
+        {
+            int32_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.i = v;
+            break;
+        }
+        case BinaryLog::kInt64:
+        {
+            int64_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.i = v;
+            break;
+        }
+        case BinaryLog::kChar:
+        {
+            char v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.i = v;
+            break;
+        }
+        case BinaryLog::kUInt8:
+        case BinaryLog::kBool:
+        {
+            uint8_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.u = v;
+            break;
+        }
+        case BinaryLog::kUInt16:
+        {
+            uint16_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.u = v;
+            break;
+        }
+        case BinaryLog::kUInt32:
+        {
+            uint32_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.u = v;
+            break;
+        }
+        case BinaryLog::kUInt64:
+        {
+            uint64_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.u = v;
+            break;
+        }
+        case BinaryLog::kPointer:
+        {
+            uintptr_t v;
+            if (!take(&v, sizeof(v)))
+                return false;
+            arg.u = v;
+            break;
+        }
+        case BinaryLog::kDouble:
+            if (!take(&arg.d, sizeof(arg.d)))
+                return false;
+            break;
+        case BinaryLog::kString:
+        {
+            uint32_t n;
+            if (!take(&n, sizeof(n)) || static_cast<size_t>(end - args) < n)
+                return false;
+            arg.s = args;
+            arg.slen = n;
+            args += n;
+            break;
+        }
+        default:
+            return false;
+        }
+        // 有符号和无符号互相补齐 方便按转换说明输出
+        if (type == BinaryLog::kUInt8 || type == BinaryLog::kUInt16 ||
+            type == BinaryLog::kUInt32 || type == BinaryLog::kUInt64 ||
+            type == BinaryLog::kPointer || type == BinaryLog::kBool)
+        {
+            arg.i = static_cast<int64_t>(arg.u);
+        }
+        else
+        {
+            arg.u = static_cast<uint64_t>(arg.i);
+        }
+        return true;
+    }
+
+    bool isSigned(char type)
+    {
+        return type == BinaryLog::kInt8 || type == BinaryLog::kInt16 ||
+               type == BinaryLog::kInt32 || type == BinaryLog::kInt64 ||
+               type == BinaryLog::kChar;
+    }
+
+    // 按spec格式化一个值追加到out 超过栈上缓冲区时直接写到out中
+    template <typename T>
+    void appendFormatted(std::string &out, const char *spec, T value)
+    {
+        char buf[128];
+        int n = ::snprintf(buf, sizeof(buf), spec, value);
+        if (n < 0)
+        {
+            return;
+        }
+        if (static_cast<size_t>(n) < sizeof(buf))
+        {
+            out.append(buf, n);
+            return;
+        }
+        size_t old = out.size();
+        out.resize(old + n + 1);
+        ::snprintf(&out[old], n + 1, spec, value);
+        out.resize(old + n);
+    }
+
+    // 把参数按转换说明输出 spec为去掉长度修饰符和转换字符的"%[flags][width][.precision]"
+    void appendArg(std::string &out, std::string &spec, char conv, const Arg &arg)
+    {
+        size_t base = spec.size();
+        if (arg.type == BinaryLog::kString)
+        {
+            // 字符串遇到任何转换字符都按%s输出
+            std::string value(arg.s, arg.slen);
+            spec += 's';
+            appendFormatted(out, spec.c_str(), value.c_str());
+        }
+        else if (strchr("eEfFgGaA", conv))
+        {
+            double value = arg.type == BinaryLog::kDouble ? arg.d
+                           : isSigned(arg.type)          ? static_cast<double>(arg.i)
+                                                         : static_cast<double>(arg.u);
+            spec += conv;
+            appendFormatted(out, spec.c_str(), value);
+        }
+        else if (conv == 'p')
+        {
+            spec += 'p';
+            appendFormatted(out, spec.c_str(), reinterpret_cast<void *>(static_cast<uintptr_t>(arg.u)));
+        }
+        else if (conv == 'c')
+        {
+            spec += 'c';
+            appendFormatted(out, spec.c_str(), static_cast<int>(arg.i));
+        }
+        else if (conv == 's')
+        {
+            // 非字符串参数用%s输出 先转成文本再套用宽度等
+            std::string text;
+            if (arg.type == BinaryLog::kBool)
+                text = arg.u ? "true" : "false";
+            else if (arg.type == BinaryLog::kDouble)
+                appendFormatted(text, "%g", arg.d);
+            else if (isSigned(arg.type))
+                appendFormatted(text, "%lld", static_cast<long long>(arg.i));
+            else
+                appendFormatted(text, "%llu", static_cast<unsigned long long>(arg.u));
+            spec += 's';
+            appendFormatted(out, spec.c_str(), text.c_str());
+        }
+        else if (conv == 'd' || conv == 'i')
+        {
+            long long value = arg.type == BinaryLog::kDouble ? static_cast<long long>(arg.d)
+                                                             : static_cast<long long>(arg.i);
+            spec += "lld";
+            appendFormatted(out, spec.c_str(), value);
+        }
+        else // o u x X
+        {
+            unsigned long long value = arg.type == BinaryLog::kDouble
+                                           ? static_cast<unsigned long long>(arg.d)
+                                           : static_cast<unsigned long long>(arg.u);
+            spec += "ll";
+            spec += conv;
+            appendFormatted(out, spec.c_str(), value);
+        }
+        spec.resize(base);
+    }
+} // namespace
+
+namespace BinaryLog
+{
+    const bool kUseTsc = detectInvariantTsc();
+
+    ClockConverter::ClockConverter()
+        : startTicks_(0), startMicros_(0), anchorTicks_(0), anchorMicros_(0),
+          ticksPerMicro_(1.0)
+    {
+        if (!kUseTsc)
+        {
+            return;
+        }
+        startTicks_ = clockNow();
+        startMicros_ = Timestamp::now().microSecondsSinceEpoch();
+        // 先用约1ms粗略估算频率 之后recalibrate时用更长的区间修正
+        int64_t micros;
+        do
+        {
+            micros = Timestamp::now().microSecondsSinceEpoch();
+        } while (micros - startMicros_ < 1000);
+        anchorTicks_ = clockNow();
+        anchorMicros_ = micros;
+        ticksPerMicro_ = static_cast<double>(anchorTicks_ - startTicks_) /
+                         static_cast<double>(anchorMicros_ - startMicros_);
+    }
+
+    void ClockConverter::recalibrate()
+    {
+        if (!kUseTsc)
+        {
+            return;
+        }
+        int64_t ticks = clockNow();
+        int64_t micros = Timestamp::now().microSecondsSinceEpoch();
+        // 系统时间被往回调整时只更新锚点 频率沿用之前的
+        if (micros - startMicros_ > 1000 && ticks > startTicks_)
+        {
+            ticksPerMicro_ = static_cast<double>(ticks - startTicks_) /
+                             static_cast<double>(micros - startMicros_);
+        }
+        anchorTicks_ = ticks;
+        anchorMicros_ = micros;
+    }
+
+    uint32_t registerSite(BinaryLogSite *site, const char *argTypes)
+    {
+        std::lock_guard<std::mutex> lock(g_siteMutex);
+        site->argTypes = argTypes;
+        uint32_t id = site->id.load(std::memory_order_relaxed);
+        if (id != 0)
+        {
+            return id; // 其他线程已经登记过
+        }
+        if (g_numSites >= kMaxSites)
+        {
+            return 0;
+        }
+        id = ++g_numSites;
+        g_sites[id].store(site, std::memory_order_release);
+        site->id.store(id, std::memory_order_release);
+        return id;
+    }
+
+    const BinaryLogSite *findSite(uint32_t id)
+    {
+        if (id == 0 || id > kMaxSites)
+        {
+            return nullptr;
+        }
+        return g_sites[id].load(std::memory_order_acquire);
+    }
+
+    void formatMessage(const char *format, const char *argTypes,
+                       const char *args, size_t len, std::string &out)
+    {
+        const char *end = args + len;
+        const char *types = argTypes;
+        const char *p = format;
+        std::string spec;
+        spec.reserve(32);
+        while (*p)
+        {
+            if (*p != '%')
+            {
+                const char *next = strchr(p, '%');
+                size_t n = next ? static_cast<size_t>(next - p) : strlen(p);
+                out.append(p, n);
+                p += n;
+                continue;
+            }
+            if (p[1] == '%')
+            {
+                out += '%';
+                p += 2;
+                continue;
+            }
+            // 解析转换说明 %[flags][width][.precision][length]conversion
+            const char *start = p++;
+            spec = "%";
+            while (*p && strchr("-+ #0'", *p))
+                spec += *p++;
+            while (isdigit(static_cast<unsigned char>(*p)))
+                spec += *p++;
+            if (*p == '.')
+            {
+                spec += *p++;
+                while (isdigit(static_cast<unsigned char>(*p)))
+                    spec += *p++;
+            }
+            // 长度修饰符按实际保存的类型重新生成
+            while (*p && strchr("hlLqjzt", *p))
+                ++p;
+            char conv = *p;
+            if (conv == '\0')
+            {
+                out.append(start);
+                break;
+            }
+            ++p;
+            Arg arg;
+            if (!strchr("diouxXcsp" "eEfFgGaA", conv) || *types == '\0' ||
+                !decodeArg(*types, args, end, arg))
+            {
+                // 不支持的转换(如*宽度、%n)或者参数不足 原样输出
+                out.append(start, p - start);
+                continue;
+            }
+            ++types;
+            appendArg(out, spec, conv, arg);
+        }
+    }
+
+    void formatRecord(const BinaryLogSite *site, const RecordHeader &header,
+                      const char *args, size_t len, std::string &out)
+    {
+        // 与Logger相同的头部 后端线程连续格式化同一线程的记录 tid字符串也缓存起来
+        static thread_local uint32_t t_lastTid = 0;
+        static thread_local char t_tidString[16];
+        static thread_local int t_tidStringLength = 0;
+        if (header.tid != t_lastTid || t_tidStringLength == 0)
+        {
+            t_tidStringLength = ::snprintf(t_tidString, sizeof(t_tidString), "%5u ", header.tid);
+            t_lastTid = header.tid;
+        }
+        char prefix[Timestamp::kFormattedSize + 1];
+        size_t n = Timestamp(header.timestamp).formatTo(prefix, true);
+        prefix[n++] = ' ';
+        out.append(prefix, n);
+        out.append(t_tidString, t_tidStringLength);
+
+        if (site == nullptr)
+        {
+            appendFormatted(out, "?????? <unknown call site %u>\n", header.siteId);
+            return;
+        }
+        out.append(getLevelName[site->level], 6);
+        formatMessage(site->format, site->argTypes, args, len, out);
+        const char *slash = strrchr(site->file, '/');
+        out += " - ";
+        out += slash ? slash + 1 : site->file;
+        out += ':';
+        appendFormatted(out, "%d", site->line);
+        out += '\n';
+    }
+
+    void writeText(const BinaryLogSite *site, const char *record, size_t len)
+    {
+        static thread_local std::string t_line;
+        RecordHeader header;
+        ::memcpy(&header, record, sizeof(header));
+        t_line.clear();
+        formatRecord(site, header, record + sizeof(header), len - sizeof(header), t_line);
+        g_output(t_line.data(), static_cast<int>(t_line.size()));
+    }
+} // namespace BinaryLog
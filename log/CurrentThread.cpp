@@ -1,14 +1,19 @@
 #include <CurrentThread.hpp>
 
+#include <stdio.h>
+
 namespace CurrentThread
 {
     thread_local int t_cachedTid = 0;
+    thread_local char t_tidString[32];
+    thread_local int t_tidStringLength = 6;
     void cacheTid()
     {
         if (t_cachedTid == 0)
         {
             // Ensure syscall and SYS_gettid are defined
             t_cachedTid = static_cast<pid_t>(::syscall(SYS_gettid));
+            t_tidStringLength = snprintf(t_tidString, sizeof(t_tidString), "%5d ", t_cachedTid);
         }
     }
 }
\ No newline at end of file
@@ -1,52 +1,128 @@
 #include <FileUtil.hpp>
+
+#include <algorithm>
 #include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-FileUtil::FileUtil(std::string &filename)
-    : file_(::fopen(filename.c_str(), "ae")), writtenBytes_(0)
+FileUtil::FileUtil(std::string &filename, off_t preallocate)
+    : fd_(::open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644)),
+      offset_(0), used_(0), writtenBytes_(0)
 {
-    // 将file_缓冲区设置为本地缓冲降低io次数。
-    ::setbuffer(file_, buffer_, sizeof(buffer_));
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "FileUtil::FileUtil() open %s failed %s\n", filename.c_str(), strerror(errno));
+        return;
+    }
+    // 同一秒内重启会打开同名文件 接在原有内容之后写
+    struct stat st;
+    if (::fstat(fd_, &st) == 0)
+    {
+        offset_ = st.st_size;
+    }
+    // 预分配失败(文件系统不支持等)不影响写入
+    if (preallocate > 0)
+    {
+        ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, offset_, preallocate);
+    }
 }
 
 FileUtil::~FileUtil()
 {
-    if (file_)
+    if (fd_ >= 0)
     {
-        ::fclose(file_);
+        flush();
+        // 释放文件末尾之后没有用到的预分配空间
+        ::ftruncate(fd_, offset_);
+        ::close(fd_);
     }
 }
 
 void FileUtil::append(const char *data, size_t len)
 {
-    size_t writen = 0;
-    while (writen != len)
+    if (used_ + len > sizeof(buffer_))
     {
-        size_t remain = len - writen;
-        size_t n = write(data + writen, remain);
-        if (n != remain)
-        {
-            // 错误判断
-            int err = ferror(file_);
-            if (err)
-            {
-                fprintf(stderr, "FileUtil::append() failed %s\n", strerror(err));
-                clearerr(file_); // 清除文件指针的错误标识
-                break;
-            }
-        }
-        writen += n;
+        flush();
+    }
+    if (len >= sizeof(buffer_))
+    {
+        // 大块数据直接写
+        struct iovec iov = {const_cast<char *>(data), len};
+        writtenBytes_ += writeFully(&iov, 1);
+        return;
+    }
+    memcpy(buffer_ + used_, data, len);
+    used_ += len;
+    writtenBytes_ += len;
+}
+
+void FileUtil::appendv(const struct iovec *iov, int count)
+{
+    flush();
+    // writeFully会修改iovec 每次拷贝一批
+    struct iovec batch[IOV_MAX];
+    while (count > 0)
+    {
+        int n = std::min(count, static_cast<int>(IOV_MAX));
+        std::copy(iov, iov + n, batch);
+        writtenBytes_ += writeFully(batch, n);
+        iov += n;
+        count -= n;
     }
-    writtenBytes_ += writen;
 }
 
 void FileUtil::flush()
 {
-    ::fflush(file_);
+    if (used_ > 0)
+    {
+        // buffer_中的数据在append时已经计入writtenBytes_
+        struct iovec iov = {buffer_, used_};
+        writeFully(&iov, 1);
+        used_ = 0;
+    }
 }
 
-// 真正向文件写入数据
-size_t FileUtil::write(const char *data, size_t len)
+size_t FileUtil::writeFully(struct iovec *iov, int count)
 {
-    // 没用选择线程安全的fwrite()为性能考虑。
-    return ::fwrite_unlocked(data, 1, len, file_);
-}
\ No newline at end of file
+    if (fd_ < 0)
+    {
+        return 0;
+    }
+    size_t total = 0;
+    while (count > 0)
+    {
+        ssize_t n = ::pwritev(fd_, iov, count, offset_);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "FileUtil::writeFully() failed %s\n", strerror(errno));
+            break;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        offset_ += n;
+        total += static_cast<size_t>(n);
+        // 跳过已经写完的段 调整写了一部分的段
+        size_t written = static_cast<size_t>(n);
+        while (count > 0 && written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return total;
+}
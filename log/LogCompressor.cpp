@@ -0,0 +1,324 @@
+#include <LogCompressor.hpp>
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+    const size_t kChunkSize = 256 * 1024;
+
+    // 当前线程使用空闲I/O优先级(IOPRIO_CLASS_IDLE) glibc没有包装ioprio_set
+    void setIdleIoPriority()
+    {
+#ifdef SYS_ioprio_set
+        const int kIoprioWhoProcess = 1;
+        const int kIoprioClassIdle = 3;
+        const int kIoprioClassShift = 13;
+        ::syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+#endif
+    }
+
+    bool writeAll(int fd, const unsigned char *data, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t n = ::write(fd, data, len);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+} // namespace
+
+LogCompressor::LogCompressor(const std::string &basename, int level,
+                             size_t keepFiles, off_t keepBytes)
+    : basename_(basename), level_(level), keepFiles_(keepFiles), keepBytes_(keepBytes),
+      running_(true), pendingFiles_(0), pendingBytes_(0), compressedFiles_(0),
+      bytesIn_(0), bytesOut_(0), removedFiles_(0),
+      thread_(std::bind(&LogCompressor::threadFunc, this), "LogCompressor")
+{
+    thread_.start();
+}
+
+LogCompressor::~LogCompressor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void LogCompressor::add(const std::string &filename)
+{
+    struct stat st;
+    off_t size = ::stat(filename.c_str(), &st) == 0 ? st.st_size : 0;
+    if (size == 0)
+    {
+        return; // 空文件(比如刚滚动就退出)不值得压缩
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(filename);
+    ++pendingFiles_;
+    pendingBytes_ += static_cast<uint64_t>(size);
+    cond_.notify_one();
+}
+
+LogCompressor::Stats LogCompressor::stats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.pendingFiles = pendingFiles_;
+        stats.pendingBytes = pendingBytes_;
+    }
+    stats.compressedFiles = compressedFiles_.load(std::memory_order_relaxed);
+    stats.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    stats.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+    stats.removedFiles = removedFiles_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void LogCompressor::threadFunc()
+{
+    // 只用空闲的CPU和磁盘带宽 不和写日志、处理请求的线程争抢 Linux上nice值是每个线程的
+    ::setpriority(PRIO_PROCESS, 0, 19);
+    setIdleIoPriority();
+    for (;;)
+    {
+        std::string filename;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return !queue_.empty() || !running_; });
+            if (queue_.empty())
+            {
+                return; // 停止并且已经处理完
+            }
+            filename = queue_.front();
+            queue_.pop_front();
+        }
+        struct stat st;
+        off_t size = ::stat(filename.c_str(), &st) == 0 ? st.st_size : 0;
+        off_t compressed = compress(filename);
+        if (compressed >= 0)
+        {
+            compressedFiles_.fetch_add(1, std::memory_order_relaxed);
+            bytesIn_.fetch_add(static_cast<uint64_t>(size), std::memory_order_relaxed);
+            bytesOut_.fetch_add(static_cast<uint64_t>(compressed), std::memory_order_relaxed);
+            enforceRetention();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pendingFiles_;
+        pendingBytes_ -= std::min(pendingBytes_, static_cast<uint64_t>(size));
+    }
+}
+
+off_t LogCompressor::compress(const std::string &filename)
+{
+    int in = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        fprintf(stderr, "LogCompressor: open %s failed %s\n", filename.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    off_t size = ::fstat(in, &st) == 0 ? st.st_size : 0;
+    // 先写临时文件 完整写完并fsync之后再改名 崩溃时不会留下半个.gz
+    std::string target = filename + ".gz";
+    std::string temp = target + ".tmp";
+    int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        fprintf(stderr, "LogCompressor: open %s failed %s\n", temp.c_str(), strerror(errno));
+        ::close(in);
+        return -1;
+    }
+
+    // 有时间索引时每块压成一个gzip member 索引项改为member在.gz中的位置
+    std::vector<LogIndex::Entry> entries;
+    LogIndex::load(filename + LogIndex::kSuffix, &entries);
+    size_t next = 0; // 下一个索引块
+    while (next < entries.size() && entries[next].offset <= 0)
+    {
+        ++next;
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // windowBits加16输出gzip格式 可以直接用zcat/zgrep查看 多个member依次解压即为原文
+    bool ok = ::deflateInit2(&stream, level_, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    std::vector<unsigned char> input(kChunkSize);
+    std::vector<unsigned char> output(kChunkSize);
+    off_t written = 0;
+    off_t readOffset = 0;
+    while (ok && readOffset < size)
+    {
+        // 读到下一块的开头为止
+        off_t limit = next < entries.size() ? std::min<off_t>(entries[next].offset, size) : size;
+        size_t want = static_cast<size_t>(std::min<off_t>(limit - readOffset, kChunkSize));
+        ssize_t n = ::read(in, input.data(), want);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ok = false;
+            break;
+        }
+        // 读过的部分不会再用 不让它占着page cache
+        ::posix_fadvise(in, readOffset, n, POSIX_FADV_DONTNEED);
+        readOffset += n;
+        int flush = readOffset == limit ? Z_FINISH : Z_NO_FLUSH;
+        stream.next_in = input.data();
+        stream.avail_in = static_cast<uInt>(n);
+        do
+        {
+            stream.next_out = output.data();
+            stream.avail_out = static_cast<uInt>(output.size());
+            ::deflate(&stream, flush);
+            size_t have = output.size() - stream.avail_out;
+            if (!writeAll(out, output.data(), have))
+            {
+                ok = false;
+                break;
+            }
+            written += static_cast<off_t>(have);
+        } while (stream.avail_out == 0);
+        if (ok && flush == Z_FINISH && readOffset < size)
+        {
+            // 下一块从新的member开始
+            ::deflateReset(&stream);
+            entries[next].offset = written;
+            ++next;
+        }
+    }
+    ::deflateEnd(&stream);
+    ::close(in);
+    if (ok && ::fsync(out) != 0)
+    {
+        ok = false;
+    }
+    if (ok)
+    {
+        ::posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    ::close(out);
+    if (ok)
+    {
+        ok = writeIndex(target, entries, next);
+    }
+    if (!ok || ::rename(temp.c_str(), target.c_str()) != 0)
+    {
+        fprintf(stderr, "LogCompressor: compress %s failed %s\n", filename.c_str(), strerror(errno));
+        ::unlink(temp.c_str());
+        ::unlink((target + LogIndex::kSuffix).c_str());
+        return -1;
+    }
+    ::unlink(filename.c_str());
+    ::unlink((filename + LogIndex::kSuffix).c_str());
+    return written;
+}
+
+bool LogCompressor::writeIndex(const std::string &target, const std::vector<LogIndex::Entry> &entries,
+                               size_t count)
+{
+    // 只保留已经换算成.gz位置的项 文件末尾之后的项(崩溃时留下的)丢掉
+    std::string path = target + LogIndex::kSuffix;
+    ::unlink(path.c_str());
+    if (count == 0)
+    {
+        return true;
+    }
+    LogIndex::Writer writer;
+    if (!writer.open(path))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        writer.append(entries[i]);
+    }
+    return true;
+}
+
+void LogCompressor::enforceRetention()
+{
+    if (keepFiles_ == 0 && keepBytes_ == 0)
+    {
+        return;
+    }
+    // LogFile的文件名为basename.YYYYmmdd-HHMMSS.log 按文件名排序就是按时间排序
+    std::string dir = ".";
+    std::string prefix = basename_;
+    size_t slash = basename_.rfind('/');
+    if (slash != std::string::npos)
+    {
+        dir = slash == 0 ? "/" : basename_.substr(0, slash);
+        prefix = basename_.substr(slash + 1);
+    }
+    prefix += '.';
+    const std::string suffix = ".log.gz";
+    DIR *d = ::opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return;
+    }
+    std::vector<std::pair<std::string, off_t>> files;
+    off_t total = 0;
+    while (struct dirent *entry = ::readdir(d))
+    {
+        std::string name = entry->d_name;
+        if (name.size() > prefix.size() + suffix.size() &&
+            name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            std::string path = dir + "/" + name;
+            struct stat st;
+            if (::stat(path.c_str(), &st) == 0)
+            {
+                files.emplace_back(path, st.st_size);
+                total += st.st_size;
+            }
+        }
+    }
+    ::closedir(d);
+    std::sort(files.begin(), files.end());
+
+    size_t count = files.size();
+    for (const auto &file : files)
+    {
+        bool tooMany = keepFiles_ != 0 && count > keepFiles_;
+        bool tooBig = keepBytes_ != 0 && total > keepBytes_;
+        if (!tooMany && !tooBig)
+        {
+            break;
+        }
+        if (::unlink(file.first.c_str()) == 0)
+        {
+            removedFiles_.fetch_add(1, std::memory_order_relaxed);
+        }
+        ::unlink((file.first + LogIndex::kSuffix).c_str());
+        --count;
+        total -= file.second;
+    }
+}
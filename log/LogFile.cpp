@@ -1,21 +1,90 @@
 #include <LogFile.hpp>
+#include <LogCompressor.hpp>
+
+#include <algorithm>
 
 LogFile::LogFile(const std::string &basename, off_t rollSize, int flushInterval,
                  int checkEveryN)
     : basename_(basename), rollSize_(rollSize), flushInterval_(flushInterval),
-      checkEveryN_(checkEveryN), startOfPeriod_(0), lastRoll_(0),
-      lastFlush_(0)
+      checkEveryN_(checkEveryN), count_(0), fileCount_(0), startOfPeriod_(0),
+      lastRoll_(0), lastFlush_(0), compressor_(nullptr), indexInterval_(0),
+      blockStart_(0), blockStartTime_(0), blockMinTime_(INT64_MAX), blockMaxTime_(INT64_MIN)
 {
     // 重新启动时，可能没有log文件，因此在构建logFile对象，直接调用rollfile()创建一个新的log文件
     rollFile();
 }
 
+LogFile::~LogFile()
+{
+    closeBlock();
+    index_.close();
+    file_.reset(); // 关闭之后再压缩
+    if (compressor_)
+    {
+        compressor_->add(filename_);
+    }
+}
+
 void LogFile::append(const char *data, int len)
 {
     std::lock_guard<std::mutex> lg(mutex_);
     appendInlock(data, len);
 }
 
+void LogFile::appendv(const struct iovec *iov, int count, int64_t minTime, int64_t maxTime)
+{
+    std::lock_guard<std::mutex> lg(mutex_);
+    file_->appendv(iov, count);
+    if (indexInterval_ > 0)
+    {
+        updateIndex(minTime, maxTime);
+    }
+    checkRollAndFlush();
+}
+
+void LogFile::setIndexInterval(off_t bytes)
+{
+    std::lock_guard<std::mutex> lg(mutex_);
+    indexInterval_ = bytes;
+    if (bytes > 0 && !index_.isOpen())
+    {
+        index_.open(filename_ + LogIndex::kSuffix);
+        blockStart_ = file_->size();
+        blockStartTime_ = time(NULL);
+    }
+}
+
+void LogFile::updateIndex(int64_t minTime, int64_t maxTime)
+{
+    blockMinTime_ = std::min(blockMinTime_, minTime);
+    blockMaxTime_ = std::max(blockMaxTime_, maxTime);
+    time_t now = time(NULL);
+    if (file_->size() - blockStart_ >= indexInterval_ || now != blockStartTime_)
+    {
+        closeBlock();
+        blockStartTime_ = now;
+    }
+}
+
+void LogFile::closeBlock()
+{
+    if (!index_.isOpen() || file_->size() == blockStart_)
+    {
+        return;
+    }
+    LogIndex::Entry entry = {blockStart_, blockMinTime_, blockMaxTime_};
+    if (blockMinTime_ > blockMaxTime_)
+    {
+        // 块中的数据没有给出时间 查询任何时间都要看这一块
+        entry.minTime = INT64_MIN;
+        entry.maxTime = INT64_MAX;
+    }
+    index_.append(entry);
+    blockStart_ = file_->size();
+    blockMinTime_ = INT64_MAX;
+    blockMaxTime_ = INT64_MIN;
+}
+
 void LogFile::flush() { file_->flush(); }
 
 bool LogFile::rollFile()
@@ -28,8 +97,26 @@ bool LogFile::rollFile()
         lastFlush_ = now;
         lastRoll_ = now;
         startOfPeriod_ = start;
+        if (file_)
+        {
+            closeBlock();
+            index_.close();
+        }
         // 让file_指向一个名为filename的文件，相当于新建了一个文件，但是rollfile一次就会创建一共file对象去将数据写到日志文件中
-        file_.reset(new FileUtil(filename));
+        file_.reset(new FileUtil(filename, rollSize_));
+        ++fileCount_;
+        // 旧文件已经关闭 交给后台压缩 当前线程不等待
+        if (compressor_ && !filename_.empty())
+        {
+            compressor_->add(filename_);
+        }
+        filename_ = filename;
+        if (indexInterval_ > 0)
+        {
+            index_.open(filename_ + LogIndex::kSuffix);
+            blockStart_ = file_->size();
+            blockStartTime_ = now;
+        }
         return true;
     }
     return false;
@@ -56,6 +143,11 @@ std::string LogFile::getLogFileName(const std::string &basename, time_t *now)
 void LogFile::appendInlock(const char *data, int len)
 {
     file_->append(data, len);
+    checkRollAndFlush();
+}
+
+void LogFile::checkRollAndFlush()
+{
     time_t now = time(NULL); // 当前时间
     ++count_;                // 写入次数加一
 
@@ -0,0 +1,148 @@
+#include <LogIndex.hpp>
+
+#include <Timestamp.hpp>
+
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    bool parseNumber(const char *p, int digits, int *value)
+    {
+        int v = 0;
+        for (int i = 0; i < digits; ++i)
+        {
+            if (p[i] < '0' || p[i] > '9')
+            {
+                return false;
+            }
+            v = v * 10 + (p[i] - '0');
+        }
+        *value = v;
+        return true;
+    }
+} // namespace
+
+bool LogIndex::TimeParser::parse(const char *line, size_t len, int64_t *micros)
+{
+    if (len < kPrefixSize)
+    {
+        return false;
+    }
+    if (::memcmp(line, cachedPrefix_, kPrefixSize) != 0)
+    {
+        // "YYYY/mm/dd HH:MM:SS"
+        struct tm tm;
+        ::memset(&tm, 0, sizeof(tm));
+        if (line[4] != '/' || line[7] != '/' || line[10] != ' ' || line[13] != ':' || line[16] != ':' ||
+            !parseNumber(line, 4, &tm.tm_year) || !parseNumber(line + 5, 2, &tm.tm_mon) ||
+            !parseNumber(line + 8, 2, &tm.tm_mday) || !parseNumber(line + 11, 2, &tm.tm_hour) ||
+            !parseNumber(line + 14, 2, &tm.tm_min) || !parseNumber(line + 17, 2, &tm.tm_sec))
+        {
+            return false;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        time_t seconds = ::mktime(&tm);
+        if (seconds == static_cast<time_t>(-1))
+        {
+            return false;
+        }
+        ::memcpy(cachedPrefix_, line, kPrefixSize);
+        cachedSeconds_ = seconds;
+    }
+    int usec = 0;
+    if (len >= Timestamp::kFormattedSize && line[kPrefixSize] == '.' &&
+        !parseNumber(line + kPrefixSize + 1, 6, &usec))
+    {
+        usec = 0;
+    }
+    *micros = cachedSeconds_ * Timestamp::kMicroSecondsPerSecond + usec;
+    return true;
+}
+
+bool LogIndex::load(const std::string &path, std::vector<Entry> *entries)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0;
+    // 写到一半的最后一项(进程崩溃)忽略掉
+    size_t count = ok ? static_cast<size_t>(st.st_size) / sizeof(Entry) : 0;
+    entries->resize(count);
+    size_t want = count * sizeof(Entry);
+    size_t got = 0;
+    while (ok && got < want)
+    {
+        ssize_t n = ::pread(fd, reinterpret_cast<char *>(entries->data()) + got, want - got, got);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            ok = false;
+            break;
+        }
+        got += static_cast<size_t>(n);
+    }
+    ::close(fd);
+    if (!ok)
+    {
+        entries->clear();
+    }
+    return ok;
+}
+
+bool LogIndex::Writer::open(const std::string &path)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "LogIndex::Writer::open() open %s failed %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    // 上次写到一半的索引项截掉 保证每项对齐
+    struct stat st;
+    if (::fstat(fd_, &st) == 0 && st.st_size % sizeof(Entry) != 0)
+    {
+        ::ftruncate(fd_, st.st_size - st.st_size % sizeof(Entry));
+    }
+    return true;
+}
+
+void LogIndex::Writer::append(const Entry &entry)
+{
+    if (fd_ < 0)
+    {
+        return;
+    }
+    ssize_t n;
+    do
+    {
+        n = ::write(fd_, &entry, sizeof(entry));
+    } while (n < 0 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(entry)))
+    {
+        fprintf(stderr, "LogIndex::Writer::append() failed %s\n", strerror(errno));
+    }
+}
+
+void LogIndex::Writer::close()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
@@ -1,31 +1,98 @@
 #include <LogStream.hpp>
-#include <alogrithm>
 
-static const char digits[] = "9876543210123456789";
+#include <charconv>
+
+namespace
+{
+    // "00".."99" 每次查表转换两位数字
+    const char kDigitPairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    const char kHexDigits[] = "0123456789abcdef";
+
+    int countDigits(uint64_t value)
+    {
+        int count = 1;
+        for (;;)
+        {
+            if (value < 10)
+                return count;
+            if (value < 100)
+                return count + 1;
+            if (value < 1000)
+                return count + 2;
+            if (value < 10000)
+                return count + 3;
+            value /= 10000;
+            count += 4;
+        }
+    }
+
+    // 位数已知 从末尾往前每次写两位 不需要再反转
+    void writeDigits(char *end, uint64_t value)
+    {
+        while (value >= 100)
+        {
+            size_t index = static_cast<size_t>(value % 100) * 2;
+            value /= 100;
+            end -= 2;
+            memcpy(end, kDigitPairs + index, 2);
+        }
+        if (value >= 10)
+        {
+            end -= 2;
+            memcpy(end, kDigitPairs + value * 2, 2);
+        }
+        else
+        {
+            *--end = static_cast<char>('0' + value);
+        }
+    }
+} // namespace
 
 template <typename T>
 void LogStream::formatInteger(T num)
 {
     if (buffer_.avail() >= kMaxNumberSize)
     {
-        char *start = buffer_.current();
-        char *cur = start;
-        static const char *zero = digits + 9;
-        bool negative = (num < 0); // 判断num是否是负数
-        do
-        {
-            int remainder = static_cast<int>(num % 10);
-            (*cur++) = zero[remainder];
-            num /= 10;
-        } while (num != 0);
-        if (negative)
+        char *cur = buffer_.current();
+        uint64_t magnitude = static_cast<uint64_t>(num);
+        if (num < T())
         {
             *cur++ = '-';
+            magnitude = 0 - magnitude;
         }
-        *cur = '\0';
-        std::reverse(start, cur);
-        int length = static_cast<int>(cur - start);
-        buffer_.add(length);
+        int length = countDigits(magnitude);
+        writeDigits(cur + length, magnitude);
+        buffer_.add(static_cast<size_t>(cur + length - buffer_.current()));
+    }
+}
+
+void LogStream::formatHex(uint64_t value, int width)
+{
+    int length = 1;
+    while (length < 16 && (value >> (length * 4)) != 0)
+    {
+        ++length;
+    }
+    if (width > length)
+    {
+        length = width < kMaxNumberSize - 2 ? width : kMaxNumberSize - 2;
+    }
+    if (buffer_.avail() >= kMaxNumberSize)
+    {
+        char *cur = buffer_.current();
+        cur[0] = '0';
+        cur[1] = 'x';
+        for (int i = length + 1; i >= 2; --i)
+        {
+            cur[i] = kHexDigits[value & 0xf];
+            value >>= 4;
+        }
+        buffer_.add(length + 2);
     }
 }
 
@@ -85,15 +152,75 @@ LogStream &LogStream::operator<<(unsigned long long num)
 
 LogStream &LogStream::operator<<(float num)
 {
-    *this << static_cast<double>(num);
+    // 按float的精度取最短形式 0.1f输出"0.1"而不是"0.10000000149"
+    if (buffer_.avail() >= kMaxNumberSize)
+    {
+        char *cur = buffer_.current();
+        std::to_chars_result result = std::to_chars(cur, cur + kMaxNumberSize, num);
+        buffer_.add(static_cast<size_t>(result.ptr - cur));
+    }
     return *this;
 }
 
 LogStream &LogStream::operator<<(double num)
 {
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%.12g", num);
-    buffer_.append(buf, strlen(buf));
+    // 最短形式最长为24个字符("-2.2250738585072014e-308")
+    if (buffer_.avail() >= kMaxNumberSize)
+    {
+        char *cur = buffer_.current();
+        std::to_chars_result result = std::to_chars(cur, cur + kMaxNumberSize, num);
+        buffer_.add(static_cast<size_t>(result.ptr - cur));
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const void *p)
+{
+    formatHex(reinterpret_cast<uintptr_t>(p), 0);
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const Hex &h)
+{
+    formatHex(h.value_, h.width_);
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const Fixed &f)
+{
+    // 超出剩余空间(比如很大的数)时不输出
+    char *cur = buffer_.current();
+    std::to_chars_result result = std::to_chars(cur, cur + buffer_.avail(), f.value_,
+                                                std::chars_format::fixed, f.precision_);
+    if (result.ec == std::errc())
+    {
+        buffer_.add(static_cast<size_t>(result.ptr - cur));
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const Padded &p)
+{
+    int digits = countDigits(p.magnitude_);
+    int length = digits + (p.negative_ ? 1 : 0);
+    int pad = p.width_ > length ? p.width_ - length : 0;
+    if (buffer_.avail() < static_cast<size_t>(length + pad) + 1)
+    {
+        return *this;
+    }
+    char *cur = buffer_.current();
+    if (p.negative_ && p.fill_ == '0')
+    {
+        *cur++ = '-';
+    }
+    memset(cur, p.fill_, pad);
+    cur += pad;
+    if (p.negative_ && p.fill_ != '0')
+    {
+        *cur++ = '-';
+    }
+    writeDigits(cur + digits, p.magnitude_);
+    buffer_.add(static_cast<size_t>(length + pad));
     return *this;
 }
 
@@ -0,0 +1,79 @@
+#include <Acceptor.hpp>
+#include <EventLoop.hpp>
+#include <InetAddress.hpp>
+#include <Logger.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+    // 水平触发下一次事件接受多个连接 连接突发时少几轮epoll_wait 也不会让mainloop长时间只处理accept
+    const int kMaxAcceptsPerEvent = 64;
+}
+
+Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
+    : loop_(loop), acceptSocket_(Socket::createNonblocking(listenAddr.family())),
+      acceptChannel_(loop, acceptSocket_.fd()), listenning_(false),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+{
+    acceptSocket_.setReuseAddr(true);
+    acceptSocket_.setReusePort(reuseport);
+    acceptSocket_.bindAddress(listenAddr);
+    acceptChannel_.setReadCallback([this](Timestamp) { handleRead(); });
+}
+
+Acceptor::~Acceptor()
+{
+    acceptChannel_.disableAll();
+    acceptChannel_.remove();
+    ::close(idleFd_);
+}
+
+void Acceptor::listen()
+{
+    listenning_ = true;
+    acceptSocket_.listen();
+    acceptChannel_.enableReading();
+}
+
+void Acceptor::handleRead()
+{
+    for (int i = 0; i < kMaxAcceptsPerEvent; ++i)
+    {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if (connfd >= 0)
+        {
+            if (newConnectionCallback_)
+            {
+                newConnectionCallback_(connfd, peerAddr);
+            }
+            else
+            {
+                ::close(connfd);
+            }
+            continue;
+        }
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN)
+        {
+            break; // 已经全部接受
+        }
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR)
+        {
+            continue;
+        }
+        LOG_ERROR << "Acceptor::handleRead accept error:" << savedErrno;
+        if (savedErrno == EMFILE)
+        {
+            // 没有fd可用时连接留在队列中 水平触发会一直通知 先腾出一个fd接受并关闭它
+            ::close(idleFd_);
+            idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+            ::close(idleFd_);
+            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+        break;
+    }
+}
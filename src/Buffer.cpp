@@ -0,0 +1,84 @@
+#include <Buffer.hpp>
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    const char kCRLF[] = "\r\n";
+    // readFd时栈上临时区的大小
+    const size_t kExtraBufferSize = 65536;
+}
+
+const char *Buffer::findCRLF(const char *start) const
+{
+    const char *p = start;
+    const char *end = beginWrite();
+#if defined(__SSE2__)
+    // 每次比较16个位置: p[i]=='\r'且p[i+1]=='\n' 需要读到p+16 所以循环条件留一个字节
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while (end - p > 16)
+    {
+        __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(cur, cr), _mm_cmpeq_epi8(next, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+    const char *crlf = std::search(p, end, kCRLF, kCRLF + 2);
+    return crlf == end ? nullptr : crlf;
+}
+
+void Buffer::makeSpace(size_t len)
+{
+    if (writableBytes() + prependableBytes() < len + kCheapPrepend)
+    {
+        // 挪动也放不下 扩容 vector按倍数增长
+        buffer_.resize(writerIndex_ + len);
+    }
+    else
+    {
+        // 前面读走的空间够用 把可读数据挪到kCheapPrepend处
+        size_t readable = readableBytes();
+        std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
+    }
+}
+
+ssize_t Buffer::readFd(int fd, int *savedErrno)
+{
+    char extrabuf[kExtraBufferSize];
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+    vec[0].iov_base = begin() + writerIndex_;
+    vec[0].iov_len = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = sizeof(extrabuf);
+    // 可写空间已经不小于临时区时只读入缓冲区 一次最多读这么多
+    const int iovcnt = writable < sizeof(extrabuf) ? 2 : 1;
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else if (static_cast<size_t>(n) <= writable)
+    {
+        writerIndex_ += static_cast<size_t>(n);
+    }
+    else
+    {
+        writerIndex_ = buffer_.size();
+        append(extrabuf, static_cast<size_t>(n) - writable);
+    }
+    return n;
+}
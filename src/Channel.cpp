@@ -1,12 +1,45 @@
+#include <sys/epoll.h>
+
 #include <Channel.hpp>
+#include <EventLoop.hpp>
 #include <Logger.hpp>
 
 const int Channel::kNoneEvent = 0;
-const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
+// EPOLLRDHUP: 对端关闭写端时直接通知 不需要再read一次读到0才发现
+const int Channel::kReadEvent = EPOLLIN | EPOLLPRI | EPOLLRDHUP;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggered = EPOLLET;
+const int Channel::kExclusive = EPOLLEXCLUSIVE;
 
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false) {}
+    : loop_(loop), fd_(fd), events_(0), mode_(0), revents_(0), index_(-1),
+      committedEvents_(kNoneEvent), pendingIndex_(-1), tied_(false) {}
+
+int Channel::events() const
+{
+    // EPOLLEXCLUSIVE只能和EPOLLIN/EPOLLOUT/EPOLLET等少数标志一起使用 否则epoll_ctl返回EINVAL
+    if (mode_ & kExclusive)
+    {
+        return (events_ & ~(EPOLLPRI | EPOLLRDHUP)) | mode_;
+    }
+    return events_ | mode_;
+}
+
+void Channel::setEdgeTriggered(bool on)
+{
+    mode_ = on ? (mode_ | kEdgeTriggered) : (mode_ & ~kEdgeTriggered);
+    // 已经注册过的channel需要重新注册才能生效
+    if (!isNoneEvent())
+    {
+        update();
+    }
+}
+
+void Channel::setExclusive(bool on)
+{
+    // 只能在注册之前设置 以EPOLLEXCLUSIVE添加的fd无法再通过MOD去掉该标志
+    mode_ = on ? (mode_ | kExclusive) : (mode_ & ~kExclusive);
+}
 
 // channel的tie方法什么时候调用过?  TcpConnection => channel
 /**
@@ -27,11 +60,32 @@ void Channel::tie(const std::shared_ptr<void> &obj)
  **/
 void Channel::update()
 {
+    // loop运行中 推迟到下一次poll之前统一提交
+    if (loop_->queueChannelUpdate(this))
+    {
+        return;
+    }
+    commitUpdate();
+}
+
+void Channel::commitUpdate()
+{
+    const int events = this->events();
+    if (events == committedEvents_)
+    {
+        return;
+    }
+    committedEvents_ = events;
     // 通过channel所属的eventloop，调用poller的相应方法，注册fd的events事件
     loop_->updateChannel(this);
 }
-// 在channel所属的EventLoop中把当前的channel删除掉
-void Channel::remove() { loop_->removeChannel(this); }
+
+// 在channel所属的EventLoop中把当前的channel删除掉 未提交的变更一并丢弃
+void Channel::remove()
+{
+    loop_->removeChannel(this);
+    committedEvents_ = kNoneEvent;
+}
 
 // fd得到Poller通知后 处理事件 handleEvent在EventLoop::loop()中被调用
 void Channel::handleEvent(Timestamp receiveTime)
@@ -59,7 +113,7 @@ void Channel::handleEvent(Timestamp receiveTime)
  */
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
-    LOG_INFO << "Channel handleEvent revents = " << revents_;
+    LOG_TRACE << "Channel handleEvent revents = " << revents_;
     // 关闭
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -84,6 +138,18 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
             readCallback_(receiveTime);
         }
     }
+    /**
+     * 对端半关闭(shutdown写端或close) 读回调已经读走了本次的数据
+     * 直接通知使用者 不需要再read一次读到0才知道对端不会再发数据了
+     * 两端都关闭时(EPOLLHUP)已经在上面走了关闭流程
+     **/
+    if ((revents_ & EPOLLRDHUP) && !(revents_ & EPOLLHUP))
+    {
+        if (halfCloseCallback_)
+        {
+            halfCloseCallback_();
+        }
+    }
     // 写
     if (revents_ & EPOLLOUT)
     {
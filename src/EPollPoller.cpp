@@ -1,6 +1,9 @@
 #include <EPollPoller.hpp>
+#include <Channel.hpp>
 #include <Logger.hpp>
 #include <errno.h>
+#include <string.h>
+#include <unistd.h>
 
 const int kNew = -1;    // 某个channel还没添加至Poller（channel的index_初始为-1）
 const int kAdded = 1;   // 某个channel已添加至Poller
@@ -32,8 +35,8 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // 由于频繁调用poll 实际上应该用LOG_DEBUG输出日志更为合理 当遇到并发场景
     // 关闭DEBUG日志提升效率
-    // LOG_INFO << "fd total count: %d" << channels_.size();
-    LOG_DEBUG << "fd total count: %d" << channels_.size();
+    // LOG_INFO << "fd total count: %d" << numChannels();
+    LOG_DEBUG << "fd total count: %d" << numChannels();
 
     int numEvents = ::epoll_wait(epollfd_, &*events_.begin(),
                                  static_cast<int>(events_.size()), timeoutMs);
@@ -70,15 +73,14 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 void EPollPoller::updateChannel(Channel *channel)
 {
     const int index = channel->index();
-    LOG_INFO << "func => "
+    LOG_DEBUG << "func => "
              << " fd " << channel->fd() << " events " << channel->events()
              << " index = " << index;
     if (index == kNew || index == kDeleted)
     {
         if (index == kNew)
         {
-            int fd = channel->fd();
-            channels_[fd] = channel;
+            addChannel(channel);
         }
         else // index == kDeleted
         {
@@ -94,6 +96,12 @@ void EPollPoller::updateChannel(Channel *channel)
             update(EPOLL_CTL_DEL, channel);
             channel->set_index(kDeleted);
         }
+        else if (channel->isExclusive())
+        {
+            // 内核不允许对EPOLLEXCLUSIVE的fd做EPOLL_CTL_MOD 只能删除后重新添加
+            update(EPOLL_CTL_DEL, channel);
+            update(EPOLL_CTL_ADD, channel);
+        }
         else
         {
             update(EPOLL_CTL_MOD, channel);
@@ -105,8 +113,8 @@ void EPollPoller::updateChannel(Channel *channel)
 void EPollPoller::removeChannel(Channel *channel)
 {
     int fd = channel->fd();
-    channels_.erase(fd);
-    LOG_INFO << "removeChannel fd = " << fd;
+    eraseChannel(fd);
+    LOG_DEBUG << "removeChannel fd = " << fd;
 
     int index = channel->index();
     if (index == kAdded)
@@ -130,7 +138,7 @@ void EPollPoller::fillActiveChannels(int numEvents,
 }
 
 // 更新channel通道 其实就是调用epoll_ctl add/mod/del
-void EPollPoller::updateChannel(int operation, Channel *channel)
+void EPollPoller::update(int operation, Channel *channel)
 {
     epoll_event event;
     ::memset(&event, 0, sizeof(event));
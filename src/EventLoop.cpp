@@ -1,12 +1,22 @@
 #include <EventLoop.hpp>
+#include <Channel.hpp>
 #include <Logger.hpp>
+#include <Poller.hpp>
+#include <TimerQueue.hpp>
+#include <algorithm>
+#include <errno.h>
 #include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 // 防止一个线程创建多个EventLoop实例,如果一个线程以及经创建了一个EventLoop实例，那么这个值会被设置成this
 thread_local EventLoop *t_loopInThisThread = nullptr;
 
 // 定义默认的Poller IO复用接口的超时时间
 const int kPollTimeMs = 10000;
+// 空闲超时时间轮的tick(毫秒)和槽数 512个1秒的槽 一圈约8.5分钟
+const int kIdleTickMs = 1000;
+const int kIdleWheelSlots = 512;
 
 /* 创建线程之后主线程和子线程谁先运行是不确定的。
  * 通过一个eventfd在线程之间传递数据的好处是多个线程无需上锁就可以实现同步。
@@ -26,19 +36,24 @@ const int kPollTimeMs = 10000;
 // 创建wakeupfd用来notify唤醒subReactor处理新来的channel
 int creatEventfd()
 {
-    int evtfd = ::evenfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
-    if (eventfd < 0)
+    int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evtfd < 0)
     {
-        LOG_FATAL << “eventfd error : % d " << errno;
+        LOG_FATAL << "eventfd error:" << errno;
     }
     return evtfd;
 }
 
 // EventLoop类的构造函数
 EventLoop::EventLoop()
-    : looping_(false), quit_(false), callingPendingFunctors_(false),
+    : looping_(false), quit_(false),
       threadId_(CurrentThread::tid()), poller_(Poller::newDefaultPoller(this)),
-      wakeupFd_(creatEventfd()), wakeupChannel_(new Channel(this, wakeupFd_))
+      timerQueue_(new TimerQueue(this)),
+      timingWheel_(kIdleTickMs, kIdleWheelSlots), wakeupFd_(creatEventfd()),
+      wakeupChannel_(new Channel(this, wakeupFd_)),
+      callingPendingFunctors_(false), wakeupPending_(false),
+      spinBudgetUs_(0), maxIdleSpins_(0), socketBusyPollUs_(0), spinning_(false),
+      idleSpins_(0), lastActiveUs_(0), spinPolls_(0), spinHits_(0), blockingPolls_(0)
 {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
     if (t_loopInThisThread)
@@ -59,10 +74,16 @@ EventLoop::EventLoop()
 // EventLoop类的析构函数
 EventLoop::~EventLoop()
 {
+    context_.reset(); // 用户对象可能持有channel 先于poller释放
     wakeupChannel_->disableAll(); // 给Channel移除所有感兴趣的事件
     wakeupChannel_->remove();     // 把Channel从EventLoop中删除
     ::close(wakeupFd_);           // 关闭wakeupFd_文件描述符
     t_loopInThisThread = nullptr; // 清除当前线程的EventLoop实例
+    // 释放loop退出后仍留在队列中的任务
+    while (MpscQueue::Node *node = pendingFunctors_.pop())
+    {
+        delete static_cast<PendingFunctor *>(node);
+    }
 }
 
 // 开启事件循环
@@ -75,13 +96,21 @@ void EventLoop::loop()
     while (!quit_)
     {
         activeChannels_.clear(); // 清除上次poller返回的活跃事件列表
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        // 上一轮回调中对关注事件的修改在poll之前一次性提交
+        flushChannelUpdates();
+        int timeoutMs = nextPollTimeout();
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        recordPoll(timeoutMs, !activeChannels_.empty());
+        // poll可能阻塞了很久 先更新时间轮的当前tick 回调中加入/touch的超时项从现在算起
+        timingWheel_.updateTime(pollReturnTime_);
         for (Channel *channel : activeChannels_)
         {
             // Poller监听哪些channel发生了事件
             // 然后上报给EventLoop通知channel处理相应的事件
             channel->handleEvent(pollReturnTime_);
         }
+        // 读事件已经touch过各自的超时项 再用本次poll返回的时间推进时间轮
+        timingWheel_.advance(pollReturnTime_);
         /**
          *执行当前EventLoop事件循环需要处理的回调操作 对于线程数 >=2 的情况 IO线程
          *mainloop(mainReactor) 主要工作： accept接收连接 =>
@@ -95,6 +124,7 @@ void EventLoop::loop()
     }
     LOG_INFO << "EventLoop stop looping";
     looping_ = false;
+    flushChannelUpdates();
 }
 /**
  * 退出事件循环
@@ -113,7 +143,7 @@ void EventLoop::loop()
 void EventLoop::quit()
 {
     quit_ = true;
-    if (!isInloopThread())
+    if (!isInLoopThread())
     {
         wakeup();
     }
@@ -128,28 +158,104 @@ void EventLoop::runInLoop(Functor cb)
     }
     else // 如果当前线程不是EventLoop所属线程
     {
-        queueInLoop(cb); // 将回调函数放入队列中，唤醒EventLoop所在线程执行cb
+        queueInLoop(std::move(cb)); // 将回调函数放入队列中，唤醒EventLoop所在线程执行cb
     }
 }
 // 把上层注册的回调函数cb放入队列中，唤醒loop所在的线程，执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
-    {
-        std::unique_lock<std::mutex> lock(
-            mutex_);                       // 上锁，保护pendingFunctors_的线程安全
-        pendingFunctors_.emplace_back(cb); // 将回调函数放入待执行队列
-    }
+    // 无锁入队 多个生产者线程之间不会互相阻塞
+    pendingFunctors_.push(new PendingFunctor(std::move(cb)));
     /**
      * || callingPendingFunctors的意思是 当前loop正在执行回调中
      *但是loop的pendingFunctors_中又加入了新的回调 需要通过wakeup写事件
      * 唤醒相应的需要执行上面回调操作的loop的线程
      *让loop()下一次poller_->poll()不再阻塞（阻塞的话会延迟前一次新加入的回调的执行），然后
      * 继续执行pendingFunctors_中的回调函数
+     *
+     * 唤醒合并: 只有把wakeupPending_从false改为true的那个生产者才write eventfd
+     * loop在处理任务队列之前才清除该标记 所以标记为true时eventfd已经写过
+     * loop一定还会再处理一次任务队列 其余生产者省掉一次write系统调用
      **/
-    if (!isInloopThread() || callingPendingFunctors_)
+    if (!isInLoopThread() || callingPendingFunctors_)
+    {
+        if (!wakeupPending_.exchange(true, std::memory_order_acq_rel))
+        {
+            wakeup(); // 唤醒loop所在的线程
+        }
+    }
+}
+
+int EventLoop::nextPollTimeout()
+{
+    if (spinning_)
     {
-        wakeup(); // 唤醒loop所在的线程
+        // 自旋预算用完或者连续空转太多次 回到阻塞的poll
+        if (idleSpins_ < maxIdleSpins_ &&
+            TimerQueue::monotonicMicroseconds() - lastActiveUs_ < spinBudgetUs_)
+        {
+            return 0;
+        }
+        spinning_ = false;
     }
+    // 时间轮中有超时项时 最多阻塞一个tick 保证时间轮能按时推进
+    return timingWheel_.empty() ? kPollTimeMs
+                                : std::min(kPollTimeMs, timingWheel_.tickMs());
+}
+
+void EventLoop::recordPoll(int timeoutMs, bool gotEvents)
+{
+    // 计数器只有loop线程写 不需要原子的读-改-写
+    if (timeoutMs == 0)
+    {
+        spinPolls_.store(spinPolls_.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        if (gotEvents)
+        {
+            spinHits_.store(spinHits_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        blockingPolls_.store(blockingPolls_.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+    }
+
+    if (spinBudgetUs_ <= 0)
+    {
+        return;
+    }
+    if (gotEvents)
+    {
+        // 有事件 重新开始一段自旋
+        spinning_ = true;
+        idleSpins_ = 0;
+        lastActiveUs_ = TimerQueue::monotonicMicroseconds();
+    }
+    else if (spinning_)
+    {
+        ++idleSpins_;
+    }
+}
+
+void EventLoop::setBusyPoll(int64_t spinBudgetUs, int maxIdleSpins, int socketBusyPollUs)
+{
+    spinBudgetUs_ = spinBudgetUs > 0 ? spinBudgetUs : 0;
+    maxIdleSpins_ = maxIdleSpins > 0 ? maxIdleSpins : 0;
+    socketBusyPollUs_ = socketBusyPollUs > 0 ? socketBusyPollUs : 0;
+    spinning_ = false;
+    idleSpins_ = 0;
+}
+
+bool EventLoop::setSocketBusyPoll(int sockfd, int usec)
+{
+    if (::setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_BUSY_POLL error fd = " << sockfd << " errno = " << errno;
+        return false;
+    }
+    return true;
 }
 
 void EventLoop::handleRead()
@@ -186,29 +292,108 @@ void EventLoop::updateChannel(Channel *channel)
 }
 void EventLoop::removeChannel(Channel *channel)
 {
+    // channel被删除后可能马上析构 不能留在待更新列表中
+    // 按记录的下标原地置空 不需要在列表中查找
+    if (channel->updatePending())
+    {
+        pendingUpdates_[channel->pendingIndex()] = nullptr;
+        channel->setPendingIndex(-1);
+    }
     poller_->removeChannel(channel);
 }
+
+bool EventLoop::queueChannelUpdate(Channel *channel)
+{
+    if (!looping_.load(std::memory_order_relaxed) || !isInLoopThread())
+    {
+        return false;
+    }
+    if (!channel->updatePending())
+    {
+        channel->setPendingIndex(static_cast<int>(pendingUpdates_.size()));
+        pendingUpdates_.push_back(channel);
+    }
+    return true;
+}
+
+// 每个channel只按最终的events提交一次 没有变化的不会调用poller
+void EventLoop::flushChannelUpdates()
+{
+    for (Channel *channel : pendingUpdates_)
+    {
+        if (channel != nullptr)
+        {
+            channel->setPendingIndex(-1);
+            channel->commitUpdate();
+        }
+    }
+    pendingUpdates_.clear();
+}
 bool EventLoop::hasChannel(Channel *channel)
 {
     return poller_->hasChannel(channel);
 }
+int EventLoop::numChannels() const
+{
+    return poller_->numChannels();
+}
 
-void EventLoop::doPendingFunctors() S
+// 定时任务 => TimerQueue
+TimerId EventLoop::runAt(Timestamp timestamp, Functor &&cb)
 {
-    std::vector<Functor> functors;
-    callingPendingFunctors_ = true; // 标记当前loop正在执行回调操作
+    return timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
+}
+TimerId EventLoop::runAfter(double waitTime, Functor &&cb)
+{
+    return timerQueue_->addTimerAfter(std::move(cb), waitTime, 0.0);
+}
+TimerId EventLoop::runEvery(double interval, Functor &&cb)
+{
+    return timerQueue_->addTimerAfter(std::move(cb), interval, interval);
+}
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
+// 粗粒度超时 => TimingWheel
+void EventLoop::addIdleTimeout(TimingWheel::Entry *entry, double timeout)
+{
+    // loop开始之前没有poll更新时间轮 从构造到现在可能已经过去很久
+    if (!looping_.load(std::memory_order_relaxed))
     {
-        std::unique_lock<std::mutex> lock(
-            mutex_); // 上锁，保护pendingFunctors_的线程安全
-        functors.swap(
-            pendingFunctors_); // 交换pendingFunctors_和functors，清空pendingFunctors_
-                               // 交换的方式减少了锁的临界区范围 提升效率
-                               // 同时避免了死锁 如果执行functor()在临界区内
-                               // 且functor()中调用queueInLoop()就会产生死锁
+        timingWheel_.updateTime(Timestamp::now());
     }
-    for (const Functor &functor : functors)
+    timingWheel_.add(entry, timeout);
+}
+void EventLoop::removeIdleTimeout(TimingWheel::Entry *entry)
+{
+    timingWheel_.remove(entry);
+}
+
+void EventLoop::doPendingFunctors()
+{
+    // 先清除唤醒标记再取任务 此后入队的生产者会重新wakeup 保证不会漏掉任务
+    // 用exchange而不是store 与生产者的exchange构成同步 保证能看到它们入队的节点
+    wakeupPending_.exchange(false, std::memory_order_acq_rel);
+
+    // 只处理此刻已经在队列中的任务 执行过程中新加入的任务留到下一轮
+    // 和原来swap出一批任务的语义一致 防止任务源源不断时loop无法回到poll
+    MpscQueue::Node *last = pendingFunctors_.back();
+    if (last == nullptr)
     {
-        functor(); // 执行当前loop所有待执行的回调函数
+        return;
+    }
+    callingPendingFunctors_ = true; // 标记当前loop正在执行回调操作
+    while (MpscQueue::Node *node = pendingFunctors_.pop())
+    {
+        PendingFunctor *pending = static_cast<PendingFunctor *>(node);
+        pending->functor(); // 执行当前loop所有待执行的回调函数
+        delete pending;
+        if (node == last)
+        {
+            break;
+        }
     }
     callingPendingFunctors_ = false; // 标记当前loop没有正在执行的回调操作
 }
\ No newline at end of file
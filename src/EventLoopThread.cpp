@@ -0,0 +1,64 @@
+#include <EventLoopThread.hpp>
+#include <EventLoop.hpp>
+
+EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
+                                 const std::string &name)
+    : loop_(nullptr), exiting_(false),
+      thread_(std::bind(&EventLoopThread::threadFunc, this), name), mutex_(),
+      cond_(), callback_(cb)
+{
+}
+
+EventLoopThread::~EventLoopThread()
+{
+    exiting_ = true;
+    if (loop_ != nullptr)
+    {
+        loop_->quit();
+        thread_.join();
+    }
+}
+
+EventLoop *EventLoopThread::startLoop()
+{
+    start();
+    return waitForLoop();
+}
+
+void EventLoopThread::start() { thread_.start(); }
+
+EventLoop *EventLoopThread::waitForLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return loop_ != nullptr; });
+    return loop_;
+}
+
+// 在单独的新线程中运行
+void EventLoopThread::threadFunc()
+{
+    EventLoop loop; // 创建一个独立的EventLoop 和上面的线程是一一对应的 one loop per thread
+
+    if (callback_)
+    {
+        callback_(&loop);
+    }
+
+    /**
+     * 不在loop()之前直接通知 而是把通知作为第一个回调交给loop执行
+     * 再主动wakeup一次让第一次poll立即返回 回调执行时loop一定已经在事件循环中了
+     * 这样startLoop()返回后 投递到该loop的任务不会因为loop还没启动而延迟
+     **/
+    loop.queueInLoop([this, &loop]()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop_ = &loop;
+        cond_.notify_one();
+    });
+    loop.wakeup();
+
+    loop.loop(); // 执行EventLoop的loop() 开启了底层的Poller的poll()
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    loop_ = nullptr;
+}
@@ -0,0 +1,163 @@
+#include <EventLoopThreadPool.hpp>
+#include <EventLoop.hpp>
+#include <EventLoopThread.hpp>
+
+#include <netinet/in.h>
+#include <string.h>
+
+/**
+ * Jump Consistent Hash(Lamping & Veach)
+ * 不需要维护哈希环 O(1)内存 buckets变化时只有约1/buckets的key会换桶
+ **/
+static int jumpConsistentHash(uint64_t key, int buckets)
+{
+    int64_t b = -1;
+    int64_t j = 0;
+    while (j < buckets)
+    {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = static_cast<int64_t>((b + 1) * (static_cast<double>(1LL << 31) /
+                                            static_cast<double>((key >> 33) + 1)));
+    }
+    return static_cast<int>(b);
+}
+
+// FNV-1a 对ip地址做哈希 不含端口 同一客户端的多个连接得到相同的值
+static uint64_t hashBytes(const void *data, size_t len)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop,
+                                         const std::string &nameArg)
+    : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0),
+      next_(0), policy_(kRoundRobin)
+{
+}
+
+// 线程中绑定的loop都是栈上的对象 不需要手动delete EventLoopThread析构时会quit并join
+EventLoopThreadPool::~EventLoopThreadPool() {}
+
+void EventLoopThreadPool::start(const ThreadInitCallback &cb)
+{
+    started_ = true;
+
+    // 先启动所有线程 各线程并行地创建loop 再逐个等待它们进入事件循环
+    for (int i = 0; i < numThreads_; ++i)
+    {
+        std::string name = name_ + std::to_string(i);
+        EventLoopThread *t = new EventLoopThread(cb, name);
+        threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+        t->start();
+    }
+    for (auto &thread : threads_)
+    {
+        loops_.push_back(thread->waitForLoop());
+    }
+
+    // 整个服务端只有一个线程运行baseLoop
+    if (numThreads_ == 0 && cb)
+    {
+        cb(baseLoop_);
+    }
+}
+
+EventLoop *EventLoopThreadPool::getNextLoop()
+{
+    // 如果只设置一个线程 也就是只有一个mainReactor 无subReactor
+    // 那么轮询只有一个线程 getNextLoop()每次都返回当前的baseLoop_
+    EventLoop *loop = baseLoop_;
+
+    if (!loops_.empty())
+    {
+        loop = loops_[next_];
+        ++next_;
+        if (next_ >= static_cast<int>(loops_.size()))
+        {
+            next_ = 0;
+        }
+    }
+    return loop;
+}
+
+EventLoop *EventLoopThreadPool::getLoopForPeer(const struct sockaddr *peerAddr)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    switch (policy_)
+    {
+    case kLeastChannels:
+        return getLeastLoadedLoop();
+    case kConsistentHash:
+        if (peerAddr != nullptr && peerAddr->sa_family == AF_INET)
+        {
+            const struct sockaddr_in *addr4 =
+                reinterpret_cast<const struct sockaddr_in *>(peerAddr);
+            return getLoopForHash(hashBytes(&addr4->sin_addr, sizeof(addr4->sin_addr)));
+        }
+        if (peerAddr != nullptr && peerAddr->sa_family == AF_INET6)
+        {
+            const struct sockaddr_in6 *addr6 =
+                reinterpret_cast<const struct sockaddr_in6 *>(peerAddr);
+            return getLoopForHash(hashBytes(&addr6->sin6_addr, sizeof(addr6->sin6_addr)));
+        }
+        return getNextLoop();
+    case kRoundRobin:
+    default:
+        return getNextLoop();
+    }
+}
+
+EventLoop *EventLoopThreadPool::getLoopForHash(uint64_t hash)
+{
+    if (loops_.empty())
+    {
+        return baseLoop_;
+    }
+    return loops_[jumpConsistentHash(hash, static_cast<int>(loops_.size()))];
+}
+
+/**
+ * subloop上注册的channel数由各自线程修改 这里读到的是近似值
+ * 从轮询位置开始比较 负载相同时依次选择不同的loop 避免一批连接同时涌入时全部落到同一个loop
+ **/
+EventLoop *EventLoopThreadPool::getLeastLoadedLoop()
+{
+    const int size = static_cast<int>(loops_.size());
+    int best = next_;
+    int bestCount = loops_[best]->numChannels();
+    for (int i = 1; i < size && bestCount > 0; ++i)
+    {
+        int index = (next_ + i) % size;
+        int count = loops_[index]->numChannels();
+        if (count < bestCount)
+        {
+            best = index;
+            bestCount = count;
+        }
+    }
+    next_ = (best + 1) % size;
+    return loops_[best];
+}
+
+std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
+{
+    if (loops_.empty())
+    {
+        return std::vector<EventLoop *>(1, baseLoop_);
+    }
+    else
+    {
+        return loops_;
+    }
+}
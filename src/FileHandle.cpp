@@ -0,0 +1,40 @@
+#include <FileHandle.hpp>
+
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileHandle::FileHandle(int fd)
+    : fd_(fd)
+{
+    if (::fstat(fd_, &stat_) != 0)
+    {
+        ::memset(&stat_, 0, sizeof(stat_));
+    }
+}
+
+FileHandle::~FileHandle()
+{
+    ::close(fd_);
+}
+
+FileHandlePtr FileHandle::open(const char *path)
+{
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return FileHandlePtr();
+    }
+    return std::make_shared<FileHandle>(fd);
+}
+
+FileHandlePtr FileHandle::dup(int fd)
+{
+    int newfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (newfd < 0)
+    {
+        return FileHandlePtr();
+    }
+    return std::make_shared<FileHandle>(newfd);
+}
@@ -0,0 +1,77 @@
+#include <InetAddress.hpp>
+#include <Logger.hpp>
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <errno.h>
+
+InetAddress::InetAddress(uint16_t port, const std::string &ip, bool ipv6)
+{
+    ::memset(&addr6_, 0, sizeof(addr6_));
+    if (ipv6 || ip.find(':') != std::string::npos)
+    {
+        addr6_.sin6_family = AF_INET6;
+        addr6_.sin6_port = htons(port);
+        addr6_.sin6_addr = in6addr_any;
+        if (!ip.empty() && ::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr) != 1)
+        {
+            LOG_ERROR << "InetAddress invalid ipv6 address " << ip;
+        }
+    }
+    else
+    {
+        addr_.sin_family = AF_INET;
+        addr_.sin_port = htons(port);
+        addr_.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (!ip.empty() && ::inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) != 1)
+        {
+            LOG_ERROR << "InetAddress invalid ipv4 address " << ip;
+        }
+    }
+}
+
+std::string InetAddress::toIp() const
+{
+    char buf[INET6_ADDRSTRLEN] = "";
+    if (family() == AF_INET6)
+    {
+        ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof(buf));
+    }
+    else
+    {
+        ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
+    }
+    return buf;
+}
+
+std::string InetAddress::toIpPort() const
+{
+    std::string ip = toIp();
+    if (family() == AF_INET6)
+    {
+        ip = "[" + ip + "]";
+    }
+    return ip + ":" + std::to_string(port());
+}
+
+InetAddress InetAddress::localAddress(int sockfd)
+{
+    InetAddress addr;
+    socklen_t len = sizeof(addr.addr6_);
+    if (::getsockname(sockfd, addr.getSockAddr(), &len) < 0)
+    {
+        LOG_ERROR << "getsockname error fd = " << sockfd << " errno = " << errno;
+    }
+    return addr;
+}
+
+InetAddress InetAddress::peerAddress(int sockfd)
+{
+    InetAddress addr;
+    socklen_t len = sizeof(addr.addr6_);
+    if (::getpeername(sockfd, addr.getSockAddr(), &len) < 0)
+    {
+        LOG_ERROR << "getpeername error fd = " << sockfd << " errno = " << errno;
+    }
+    return addr;
+}
@@ -0,0 +1,431 @@
+#include <IoUringPoller.hpp>
+#include <Channel.hpp>
+#include <Logger.hpp>
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+const int kNew = -1;    // 某个channel还没添加至Poller（channel的index_初始为-1）
+const int kAdded = 1;   // 某个channel已添加至Poller
+const int kDeleted = 2; // 某个channel已经从Poller中删除
+
+// POLL_REMOVE自身的完成事件使用的user_data 收割时直接跳过
+static const uint64_t kCancelTag = ~0ULL;
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop), ringFd_(-1), sqRing_(nullptr), sqRingSize_(0),
+      sqHead_(nullptr), sqTail_(nullptr), sqMask_(nullptr), sqArray_(nullptr),
+      sqes_(nullptr), sqesSize_(0), sqTailLocal_(0), cqRing_(nullptr),
+      cqRingSize_(0), cqHead_(nullptr), cqTail_(nullptr), cqMask_(nullptr),
+      cqes_(nullptr), batch_(0)
+{
+    if (!setupRing())
+    {
+        LOG_WARN << "IoUringPoller::IoUringPoller io_uring setup failed:" << errno;
+        teardownRing();
+    }
+}
+
+IoUringPoller::~IoUringPoller() { teardownRing(); }
+
+bool IoUringPoller::setupRing()
+{
+    struct io_uring_params params;
+    ::memset(&params, 0, sizeof(params));
+    // 只有loop线程提交SQE 告诉内核可以省掉提交时的同步以及跨核的任务通知
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+    int fd = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if (fd < 0 && errno == EINVAL)
+    {
+        // 老内核不认识上面的flags
+        ::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    }
+    if (fd < 0)
+    {
+        return false;
+    }
+    ringFd_ = fd;
+
+    // poll()的超时依赖EXT_ARG(5.11) 完成事件不能丢依赖NODROP(5.5)
+    if (!(params.features & IORING_FEAT_EXT_ARG) ||
+        !(params.features & IORING_FEAT_NODROP))
+    {
+        errno = ENOSYS;
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        sqRing_ = nullptr;
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            cqRing_ = nullptr;
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // SQ的下标数组固定为恒等映射 之后只需要移动队尾
+    for (unsigned i = 0; i < params.sq_entries; ++i)
+    {
+        sqArray_[i] = i;
+    }
+    sqTailLocal_ = *sqTail_;
+    return true;
+}
+
+void IoUringPoller::teardownRing()
+{
+    if (sqes_)
+    {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+    if (ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+IoUringPoller::FdState &IoUringPoller::stateOf(int fd)
+{
+    if (static_cast<size_t>(fd) >= fdStates_.size())
+    {
+        fdStates_.resize(std::max<size_t>(fd + 1, fdStates_.size() * 2),
+                         FdState{0, false, false, false, 0});
+    }
+    return fdStates_[fd];
+}
+
+unsigned IoUringPoller::pendingSqes() const
+{
+    return sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+}
+
+struct io_uring_sqe *IoUringPoller::getSqe()
+{
+    // SQ满了就先把已有的提交掉 不等待完成事件
+    // 只有内核取走(sqHead_越过)的位置才能复用 提交失败或者只提交了一部分时继续重试
+    while (pendingSqes() > *sqMask_)
+    {
+        if (enter(pendingSqes(), 0, 0) >= 0)
+        {
+            continue;
+        }
+        int savedErrno = errno;
+        if (savedErrno == EINTR || savedErrno == EAGAIN)
+        {
+            continue;
+        }
+        if (savedErrno == EBUSY)
+        {
+            // CQ溢出时内核拒绝提交 把完成事件移出CQ 留到下一次poll()处理
+            stashCompletions();
+            continue;
+        }
+        LOG_FATAL << "IoUringPoller::getSqe io_uring_enter error:" << savedErrno;
+    }
+    struct io_uring_sqe *sqe = &sqes_[sqTailLocal_ & *sqMask_];
+    ++sqTailLocal_;
+    ::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUringPoller::enter(unsigned toSubmit, unsigned waitNr, int timeoutMs)
+{
+    // 发布队尾 内核从这里看到新的SQE
+    __atomic_store_n(sqTail_, sqTailLocal_, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    void *argp = nullptr;
+    size_t argsz = 0;
+    if (waitNr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            ::memset(&arg, 0, sizeof(arg));
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+            argp = &arg;
+            argsz = sizeof(arg);
+        }
+    }
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, toSubmit,
+                                      waitNr, flags, argp, argsz));
+}
+
+void IoUringPoller::armPoll(Channel *channel)
+{
+    FdState &state = stateOf(channel->fd());
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = channel->fd();
+    // EPOLLET不传给io_uring 边沿触发由multishot实现
+    sqe->poll32_events = static_cast<uint32_t>(channel->events() & ~EPOLLET);
+    sqe->user_data = encode(channel->fd(), state.sequence);
+    // EPOLLEXCLUSIVE不能与multishot同时使用 独占的channel总是一次性的
+    state.multishot = channel->isEdgeTriggered() && !channel->isExclusive();
+    if (state.multishot)
+    {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    state.armed = true;
+    state.rearm = false;
+}
+
+void IoUringPoller::cancelPoll(int fd, uint32_t sequence)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encode(fd, sequence);
+    sqe->user_data = kCancelTag;
+}
+
+/**
+ * 等待并处理IO事件
+ * 本轮积累的所有关注事件变更(SQE)和等待在同一次io_uring_enter中完成
+ */
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_DEBUG << "fd total count: " << numChannels();
+
+    rearmFiredChannels();
+    int ret = enter(pendingSqes(), 1, timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    // 超时或被信号打断时完成队列中也可能已经有事件 总是收割一次
+    size_t before = activeChannels->size();
+    reapCompletions(activeChannels);
+    size_t numEvents = activeChannels->size() - before;
+
+    if (numEvents > 0)
+    {
+        LOG_DEBUG << "events happened " << numEvents;
+    }
+    else if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR << "IoUringPoller::poll() error:" << saveErrno;
+    }
+    return now;
+}
+
+void IoUringPoller::reapCompletions(ChannelList *activeChannels)
+{
+    ++batch_;
+    // 先处理提交时因为CQ溢出而提前移出的完成事件 保持与到达顺序一致
+    for (const struct io_uring_cqe &cqe : stashedCqes_)
+    {
+        handleCompletion(cqe, activeChannels);
+    }
+    stashedCqes_.clear();
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        handleCompletion(cqes_[head & *cqMask_], activeChannels);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::stashCompletions()
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        stashedCqes_.push_back(cqes_[head & *cqMask_]);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::handleCompletion(const struct io_uring_cqe &cqe, ChannelList *activeChannels)
+{
+    if (cqe.user_data == kCancelTag)
+    {
+        return;
+    }
+    int fd = static_cast<int>(cqe.user_data >> 32);
+    uint32_t sequence = static_cast<uint32_t>(cqe.user_data);
+    if (static_cast<size_t>(fd) >= fdStates_.size())
+    {
+        return;
+    }
+    FdState &state = fdStates_[fd];
+    // fd已经被删除、修改过关注事件或者被复用 这是迟到的完成事件
+    if (state.sequence != sequence || !state.armed)
+    {
+        return;
+    }
+    Channel *channel = findChannel(fd);
+    if (channel == nullptr)
+    {
+        return;
+    }
+    // 一次性的POLL_ADD已经结束 multishot没有IORING_CQE_F_MORE标志也说明已经结束(比如出错)
+    // 两种情况都需要在下一次poll()时重新挂上
+    if (!state.multishot || !(cqe.flags & IORING_CQE_F_MORE))
+    {
+        state.armed = false;
+        state.rearm = true;
+        rearmFds_.push_back(fd);
+    }
+
+    int revents = cqe.res < 0 ? static_cast<int>(EPOLLERR) : cqe.res;
+    if (state.batch == batch_)
+    {
+        // multishot在同一批中产生了多个事件 合并到已经在活跃列表中的channel上
+        channel->set_revents(channel->revents() | revents);
+        return;
+    }
+    state.batch = batch_;
+    channel->set_revents(revents);
+    activeChannels->push_back(channel);
+}
+
+// 上一轮触发过的channel按当前的events重新挂上POLL_ADD 回调中对events的修改在这里一并生效
+void IoUringPoller::rearmFiredChannels()
+{
+    for (int fd : rearmFds_)
+    {
+        FdState &state = fdStates_[fd];
+        if (!state.rearm)
+        {
+            continue;
+        }
+        state.rearm = false;
+        Channel *channel = findChannel(fd);
+        if (channel != nullptr && channel->index() == kAdded &&
+            !channel->isNoneEvent())
+        {
+            ++state.sequence;
+            armPoll(channel);
+        }
+    }
+    rearmFds_.clear();
+}
+
+// channel update remove => EventLoop updateChannel removeChannel => Poller
+// updateChannel removeChannel
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG << "func => fd " << fd << " events " << channel->events()
+              << " index = " << index;
+    FdState &state = stateOf(fd);
+    if (index == kNew || index == kDeleted)
+    {
+        if (index == kNew)
+        {
+            addChannel(channel);
+        }
+        channel->set_index(kAdded);
+        ++state.sequence;
+        armPoll(channel);
+    }
+    else // channel已经在Poller中注册过了
+    {
+        if (channel->isNoneEvent())
+        {
+            if (state.armed)
+            {
+                cancelPoll(fd, state.sequence);
+            }
+            ++state.sequence;
+            state.armed = false;
+            state.rearm = false;
+            channel->set_index(kDeleted);
+        }
+        else if (state.armed)
+        {
+            // 替换掉还未触发的POLL_ADD
+            cancelPoll(fd, state.sequence);
+            ++state.sequence;
+            armPoll(channel);
+        }
+        // 否则事件已经触发 等待重新挂上 届时会使用新的events
+    }
+}
+
+// 从Poller中删除channel
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    eraseChannel(fd);
+    LOG_DEBUG << "removeChannel fd = " << fd;
+
+    FdState &state = stateOf(fd);
+    if (channel->index() == kAdded && state.armed)
+    {
+        cancelPoll(fd, state.sequence);
+    }
+    ++state.sequence;
+    state.armed = false;
+    state.rearm = false;
+    channel->set_index(kNew);
+}
@@ -1,11 +1,11 @@
 #include <CurrentThread.hpp>
 #include <Logger.hpp>
 
+#include <mutex>
+
 namespace ThreadInfo
 {
     thread_local char t_errnobuf[512]; // 每个线程独立的错误信息缓冲
-    thread_local char t_timer[64];     // 每个线程独立的时间格式化缓冲区
-    thread_local time_t t_lastSecond;  // 每个线程记录上次格式化的时间
 } // namespace ThreadInfo
 
 const char *getErrnoMsg(int savedErrno)
@@ -14,16 +14,78 @@ const char *getErrnoMsg(int savedErrno)
                       sizeof(ThreadInfo::t_errnobuf));
 }
 
-// 根据Level 返回level_名字
+// 根据Level 返回level_名字 补齐到6个字符 与写入时的长度一致
 const char *getLevelName[Logger::LogLevel::LEVEL_COUNT]{
-    "TRACE",
-    "DEBUG",
-    "INFO",
-    "WARN",
-    "ERROR",
-    "FATAL",
+    "TRACE ",
+    "DEBUG ",
+    "INFO  ",
+    "WARN  ",
+    "ERROR ",
+    "FATAL ",
 };
 
+std::atomic<int> g_logLevel(Logger::INFO);
+
+namespace
+{
+    // 所有日志模块组成的链表 只在注册/注销和修改模块等级时加锁
+    // 用函数内的静态变量 保证其他翻译单元的静态初始化期间注册模块时已经构造好
+    std::mutex &moduleMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+    LogModule *&moduleList()
+    {
+        static LogModule *head = nullptr;
+        return head;
+    }
+
+    // 等级最高只能设到FATAL 越界的值不能让LOG_FATAL失效
+    int clampLevel(Logger::LogLevel level)
+    {
+        if (level < Logger::TRACE)
+        {
+            return Logger::TRACE;
+        }
+        return level > Logger::FATAL ? Logger::FATAL : level;
+    }
+} // namespace
+
+LogModule::LogModule(const char *path) : next_(nullptr)
+{
+    // 去掉目录和后缀 "src/EPollPoller.cpp" => "EPollPoller"
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    size_t len = strlen(base);
+    const char *dot = strrchr(base, '.');
+    if (dot && dot != base)
+    {
+        len = static_cast<size_t>(dot - base);
+    }
+    len = len < sizeof(name_) - 1 ? len : sizeof(name_) - 1;
+    memcpy(name_, base, len);
+    name_[len] = '\0';
+    level_.store(kInherit, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(moduleMutex());
+    next_ = moduleList();
+    moduleList() = this;
+}
+
+LogModule::~LogModule()
+{
+    std::lock_guard<std::mutex> lock(moduleMutex());
+    for (LogModule **p = &moduleList(); *p; p = &(*p)->next_)
+    {
+        if (*p == this)
+        {
+            *p = next_;
+            break;
+        }
+    }
+}
+
 /**
  * 默认的日志输出函数
  * 将日志内容写入标准输出流(stdout)
@@ -44,12 +106,23 @@ static void defaultFlush() { fflush(stdout); }
 
 Logger::OutputFunc g_output = defalutOutput;
 Logger::FlushFunc g_flush = defaultFlush;
+LogSink *g_sink = nullptr;
 
 Logger::Impl::Impl(LogLevel level, int savedErrno, const char *filename,
                    int line)
-    : time_(Timestamp::now()), stream_(), level_(level), line_(line),
+    : time_(Timestamp::now()), stream_(), sink_(nullptr), level_(level), line_(line),
       basename_(filename)
 {
+    // 有就地格式化的后端时 整条日志直接写到后端预留的内存中
+    if (g_sink)
+    {
+        char *data = g_sink->reserve(kSmallBufferSize);
+        if (data)
+        {
+            sink_ = g_sink;
+            stream_.attach(data, kSmallBufferSize);
+        }
+    }
     // 根据时区格式化当前时间字符串, 也是一条log消息的开头
     formatTime();
     // 写入日志等级
@@ -59,28 +132,15 @@ Logger::Impl::Impl(LogLevel level, int savedErrno, const char *filename,
         stream_ << getErrnoMsg(savedErrno) << " (errno=" << savedErrno << ") ";
     }
 }
-// 根据时区格式化当前时间字符串, 也是一条log消息的开头
+// 日志头部: 时间(精确到微秒)和tid 如"2025/08/26 16:29:10.773804  1234 "
 void Logger::Impl::formatTime()
 {
-    Timestamp now = Timestamp::now();
-    // 计算秒数
-    time_t seconds = static_cast<time_t>(now.secondsSinceEpoch());
-    // 计算剩余微秒数
-    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() %
-                                        Timestamp::kMicroSecondsPerSecond);
-    struct tm *tm_time = localtime(&seconds);
-    // 写入此线程存储的时间buf中
-    snprintf(ThreadInfo::t_timer, sizeof(ThreadInfo::t_timer),
-             "%4d/%02d/%02d %02d:%02d:%02d", tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1, tm_time->tm_mday, tm_time->tm_hour,
-             tm_time->tm_min, tm_time->tm_sec);
-    ThreadInfo::t_lastSecond = seconds;
-
-    char buf[32] = {0};
-    snprintf(buf, sizeof(buf), "%06d", microseconds);
-
-    stream_ << GeneralTemplate(ThreadInfo::t_timer, 17)
-            << GeneralTemplate(buf, 6);
+    char buf[Timestamp::kFormattedSize + 1];
+    size_t len = time_.formatTo(buf, true);
+    buf[len++] = ' ';
+    CurrentThread::tid();
+    stream_ << GeneralTemplate(buf, static_cast<int>(len))
+            << GeneralTemplate(CurrentThread::tidString(), CurrentThread::tidStringLength());
 }
 
 void Logger::Impl::finish()
@@ -97,11 +157,22 @@ Logger::~Logger()
 {
     impl_.finish();
     const LogStream::Buffer &buffer = stream().buffer();
-    // 输出(默认项终端输出)
-    g_output(buffer.data(), buffer.length());
+    if (impl_.sink_)
+    {
+        impl_.sink_->commit(buffer.data(), buffer.length());
+    }
+    else
+    {
+        // 输出(默认项终端输出)
+        g_output(buffer.data(), buffer.length());
+    }
     // FATAL情况终止程序
     if (impl_.level_ == FATAL)
     {
+        if (impl_.sink_)
+        {
+            impl_.sink_->flush();
+        }
         g_flush();
         abort(); // 该函数用于异常终止程序的执行,它会立即终止调用进程.
     }
@@ -115,4 +186,50 @@ void Logger::setOutput(OutputFunc output)
 void Logger::setFlush(FlushFunc flush)
 {
     g_flush = flush;
+}
+
+void Logger::setSink(LogSink *sink)
+{
+    g_sink = sink;
+}
+
+Logger::LogLevel Logger::logLevel()
+{
+    return static_cast<LogLevel>(g_logLevel.load(std::memory_order_relaxed));
+}
+
+void Logger::setLogLevel(LogLevel level)
+{
+    g_logLevel.store(clampLevel(level), std::memory_order_relaxed);
+}
+
+// 同名的模块可能有多个(多个源文件定义了相同的LOG_MODULE) 一并修改
+int Logger::setModuleLevel(const char *module, LogLevel level)
+{
+    int matched = 0;
+    std::lock_guard<std::mutex> lock(moduleMutex());
+    for (LogModule *m = moduleList(); m; m = m->next_)
+    {
+        if (strcmp(m->name_, module) == 0)
+        {
+            m->level_.store(clampLevel(level) + 1, std::memory_order_relaxed);
+            ++matched;
+        }
+    }
+    return matched;
+}
+
+int Logger::resetModuleLevel(const char *module)
+{
+    int matched = 0;
+    std::lock_guard<std::mutex> lock(moduleMutex());
+    for (LogModule *m = moduleList(); m; m = m->next_)
+    {
+        if (strcmp(m->name_, module) == 0)
+        {
+            m->level_.store(LogModule::kInherit, std::memory_order_relaxed);
+            ++matched;
+        }
+    }
+    return matched;
 }
\ No newline at end of file
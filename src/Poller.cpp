@@ -1,22 +1,73 @@
 #include <Poller.hpp>
 #include <Channel.hpp>
 #include <EPollPoller.hpp>
+#include <IoUringPoller.hpp>
+#include <Logger.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+const size_t kInitChannelTableSize = 64; // 初始槽位数 覆盖常见的小fd
+}
+
+Poller::Poller(EventLoop *loop)
+    : channels_(kInitChannelTableSize, nullptr), numChannels_(0), ownerLoop_(loop) {}
 
-Poller::Poller(EventLoop *loop) : ownerLoop_(loop) {}
 bool Poller::hasChannel(Channel *channel) const
 {
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return findChannel(channel->fd()) == channel;
 }
 
-Poller *Poller::newDefaultPoller(EventLoop *loop)
+void Poller::addChannel(Channel *channel)
+{
+    size_t fd = static_cast<size_t>(channel->fd());
+    if (fd >= channels_.size())
+    {
+        // 按2倍扩容 连续打开的fd不会每次都扩容
+        size_t newSize = channels_.size() * 2;
+        while (newSize <= fd)
+        {
+            newSize *= 2;
+        }
+        channels_.resize(newSize, nullptr);
+    }
+    if (channels_[fd] == nullptr)
+    {
+        numChannels_.fetch_add(1, std::memory_order_relaxed);
+    }
+    channels_[fd] = channel;
+}
+
+bool Poller::eraseChannel(int fd)
 {
-    if (::getenv("MUDUO_USE_POLL"))
+    if (static_cast<size_t>(fd) >= channels_.size() || channels_[fd] == nullptr)
     {
-        return nullptr;
+        return false;
     }
-    else
+    channels_[fd] = nullptr;
+    numChannels_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * 通过环境变量WEBSERVER_POLLER选择IO复用的实现
+ * WEBSERVER_POLLER=io_uring 使用io_uring 内核不支持或被禁用时回退到epoll
+ * 未设置或其他取值 使用epoll
+ **/
+Poller *Poller::newDefaultPoller(EventLoop *loop)
+{
+    const char *backend = ::getenv("WEBSERVER_POLLER");
+    if (backend && ::strcmp(backend, "io_uring") == 0)
     {
-        return new EPollPoller(loop);
+        IoUringPoller *poller = new IoUringPoller(loop);
+        if (poller->valid())
+        {
+            return poller;
+        }
+        LOG_WARN << "io_uring is not available, fall back to epoll";
+        delete poller;
     }
-}
\ No newline at end of file
+    return new EPollPoller(loop);
+}
@@ -0,0 +1,106 @@
+#include <Socket.hpp>
+#include <InetAddress.hpp>
+#include <Logger.hpp>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+Socket::~Socket()
+{
+    ::close(sockfd_);
+}
+
+int Socket::createNonblocking(sa_family_t family)
+{
+    int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+        LOG_FATAL << "Socket::createNonblocking error:" << errno;
+    }
+    return sockfd;
+}
+
+void Socket::bindAddress(const InetAddress &localaddr)
+{
+    if (::bind(sockfd_, localaddr.getSockAddr(), localaddr.sockAddrLength()) != 0)
+    {
+        LOG_FATAL << "bind sockfd:" << sockfd_ << " " << localaddr.toIpPort() << " error:" << errno;
+    }
+}
+
+void Socket::listen()
+{
+    if (::listen(sockfd_, SOMAXCONN) != 0)
+    {
+        LOG_FATAL << "listen sockfd:" << sockfd_ << " error:" << errno;
+    }
+}
+
+int Socket::accept(InetAddress *peeraddr)
+{
+    struct sockaddr_in6 addr;
+    socklen_t len = sizeof(addr);
+    // accept4直接设置非阻塞和close-on-exec 省掉两次fcntl
+    int connfd = ::accept4(sockfd_, reinterpret_cast<struct sockaddr *>(&addr), &len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (connfd >= 0)
+    {
+        if (addr.sin6_family == AF_INET6)
+        {
+            *peeraddr = InetAddress(addr);
+        }
+        else
+        {
+            *peeraddr = InetAddress(*reinterpret_cast<struct sockaddr_in *>(&addr));
+        }
+    }
+    return connfd;
+}
+
+void Socket::shutdownWrite()
+{
+    if (::shutdown(sockfd_, SHUT_WR) < 0)
+    {
+        LOG_ERROR << "shutdownWrite error fd = " << sockfd_ << " errno = " << errno;
+    }
+}
+
+void Socket::setTcpNoDelay(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+}
+
+void Socket::setReuseAddr(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+}
+
+void Socket::setReusePort(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0 && on)
+    {
+        LOG_ERROR << "SO_REUSEPORT failed fd = " << sockfd_ << " errno = " << errno;
+    }
+}
+
+void Socket::setKeepAlive(bool on)
+{
+    int optval = on ? 1 : 0;
+    ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+}
+
+int Socket::getSocketError(int sockfd)
+{
+    int optval = 0;
+    socklen_t optlen = sizeof(optval);
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
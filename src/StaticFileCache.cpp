@@ -0,0 +1,390 @@
+#include <StaticFileCache.hpp>
+#include <Channel.hpp>
+#include <EventLoop.hpp>
+#include <Logger.hpp>
+#include <TcpConnection.hpp>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    // 文件内容变化、被移动/删除、链接数变化(被rename覆盖)
+    const uint32_t kWatchMask = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+
+    struct MimeType
+    {
+        const char *ext;
+        const char *type;
+    };
+    const MimeType kMimeTypes[] = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript"},
+        {"json", "application/json"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "application/xml"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"webp", "image/webp"},
+        {"woff2", "font/woff2"},
+        {"wasm", "application/wasm"},
+        {"pdf", "application/pdf"},
+        {"gz", "application/gzip"},
+    };
+
+    const char *mimeTypeOf(const std::string &path)
+    {
+        size_t dot = path.rfind('.');
+        if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+        {
+            const char *ext = path.c_str() + dot + 1;
+            for (const MimeType &mime : kMimeTypes)
+            {
+                if (::strcasecmp(ext, mime.ext) == 0)
+                {
+                    return mime.type;
+                }
+            }
+        }
+        return "application/octet-stream";
+    }
+
+    // 去掉开头的'/' 拒绝空路径和".."
+    bool normalizePath(const std::string &path, std::string *rel)
+    {
+        size_t start = path.find_first_not_of('/');
+        if (start == std::string::npos)
+        {
+            return false;
+        }
+        rel->assign(path, start, std::string::npos);
+        size_t pos = 0;
+        while (pos <= rel->size())
+        {
+            size_t end = rel->find('/', pos);
+            if (end == std::string::npos)
+            {
+                end = rel->size();
+            }
+            if (end - pos == 2 && (*rel)[pos] == '.' && (*rel)[pos + 1] == '.')
+            {
+                return false;
+            }
+            pos = end + 1;
+        }
+        return true;
+    }
+
+    std::string buildHeader(const struct stat &st, const char *contentType, const std::string &etag)
+    {
+        struct tm tm;
+        ::gmtime_r(&st.st_mtim.tv_sec, &tm);
+        char date[64];
+        ::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        char header[512];
+        int n = ::snprintf(header, sizeof(header),
+                           "HTTP/1.1 200 OK\r\n"
+                           "Content-Length: %" PRId64 "\r\n"
+                           "Content-Type: %s\r\n"
+                           "Last-Modified: %s\r\n"
+                           "ETag: %s\r\n"
+                           "\r\n",
+                           static_cast<int64_t>(st.st_size), contentType, date, etag.c_str());
+        return std::string(header, n);
+    }
+
+    // 读入整个文件 文件在读的过程中变短时返回false
+    bool readAll(int fd, char *buf, size_t len)
+    {
+        size_t done = 0;
+        while (done < len)
+        {
+            ssize_t n = ::pread(fd, buf + done, len - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+StaticFileCache::StaticFileCache(EventLoop *loop, const std::string &root, const Options &options)
+    : loop_(loop), root_(root), options_(options),
+      rootFd_(::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)),
+      inotifyFd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      memoryBytes_(0), hits_(0), misses_(0), invalidations_(0), evictions_(0),
+      numEntries_(0), statMemoryBytes_(0)
+{
+    if (rootFd_ < 0)
+    {
+        LOG_FATAL << "StaticFileCache open root " << root_ << " errno = " << errno;
+    }
+    if (inotifyFd_ < 0)
+    {
+        LOG_FATAL << "StaticFileCache inotify_init1 errno = " << errno;
+    }
+    inotifyChannel_.reset(new Channel(loop_, inotifyFd_));
+    inotifyChannel_->setReadCallback([this](Timestamp) { handleInotify(); });
+    inotifyChannel_->enableReading();
+}
+
+StaticFileCache::~StaticFileCache()
+{
+    inotifyChannel_->disableAll();
+    inotifyChannel_->remove();
+    ::close(inotifyFd_); // 关闭时内核删除所有watch
+    ::close(rootFd_);
+}
+
+StaticFileCache::EntryPtr StaticFileCache::lookup(const std::string &path)
+{
+    std::string rel;
+    if (!normalizePath(path, &rel))
+    {
+        return EntryPtr();
+    }
+    auto it = entries_.find(rel);
+    if (it != entries_.end())
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return *it->second.lru;
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return load(rel);
+}
+
+void StaticFileCache::sendEntry(const TcpConnectionPtr &conn, const EntryPtr &entry)
+{
+    if (!entry->response.empty())
+    {
+        conn->send(entry->response);
+    }
+    else
+    {
+        conn->send(entry->header);
+        conn->sendFile(entry->file, 0, static_cast<size_t>(entry->size));
+    }
+}
+
+StaticFileCache::Stats StaticFileCache::stats() const
+{
+    Stats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.invalidations = invalidations_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.entries = numEntries_.load(std::memory_order_relaxed);
+    stats.memoryBytes = statMemoryBytes_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+StaticFileCache::EntryPtr StaticFileCache::load(const std::string &path)
+{
+    // 先加watch再打开 之后的任何修改都会产生事件
+    std::string fullPath = root_ + "/" + path;
+    int wd = ::inotify_add_watch(inotifyFd_, fullPath.c_str(), kWatchMask);
+    if (wd < 0)
+    {
+        if (errno == ENOENT || errno == ENOTDIR || errno == EACCES)
+        {
+            return EntryPtr();
+        }
+        LOG_ERROR << "StaticFileCache inotify_add_watch " << fullPath << " errno = " << errno;
+    }
+    // O_NONBLOCK: 路径是FIFO时open不会阻塞 随后因为不是普通文件被拒绝
+    int fd = ::openat(rootFd_, path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    FileHandlePtr file = fd >= 0 ? std::make_shared<FileHandle>(fd) : FileHandlePtr();
+    if (!file || !file->isRegular())
+    {
+        releaseWatch(wd, path);
+        return EntryPtr();
+    }
+
+    const struct stat &st = file->stat();
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->path = path;
+    entry->size = st.st_size;
+    entry->mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    char etag[64];
+    ::snprintf(etag, sizeof(etag), "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "\"", static_cast<uint64_t>(st.st_ino),
+               static_cast<uint64_t>(st.st_size), static_cast<uint64_t>(entry->mtimeNs));
+    entry->etag = etag;
+    std::string header = buildHeader(st, mimeTypeOf(path), entry->etag);
+
+    if (static_cast<size_t>(st.st_size) <= options_.smallFileLimit)
+    {
+        // 响应头和内容放在同一块内存中 发送时只有一段
+        std::string response(header);
+        response.resize(header.size() + static_cast<size_t>(st.st_size));
+        if (!readAll(file->fd(), &response[header.size()], static_cast<size_t>(st.st_size)))
+        {
+            releaseWatch(wd, path); // 正在被改写 这次当作不存在
+            return EntryPtr();
+        }
+        entry->response = SharedSlice::copyFrom(response);
+        entry->header = entry->response.subslice(0, header.size());
+    }
+    else
+    {
+        entry->file = std::move(file);
+        entry->header = SharedSlice::copyFrom(header);
+    }
+
+    if (wd >= 0)
+    {
+        insert(entry, wd);
+    }
+    return entry;
+}
+
+void StaticFileCache::insert(const EntryPtr &entry, int wd)
+{
+    lru_.push_front(entry);
+    entries_[entry->path] = Slot{lru_.begin(), wd};
+    watches_[wd].push_back(entry->path);
+    memoryBytes_ += memoryOf(*entry);
+    evict();
+    updateStats();
+}
+
+void StaticFileCache::erase(const std::string &path)
+{
+    auto it = entries_.find(path);
+    if (it == entries_.end())
+    {
+        return;
+    }
+    memoryBytes_ -= memoryOf(**it->second.lru);
+    lru_.erase(it->second.lru);
+    int wd = it->second.wd;
+    entries_.erase(it);
+    releaseWatch(wd, path);
+}
+
+void StaticFileCache::evict()
+{
+    while (!lru_.empty() && (entries_.size() > options_.maxEntries || memoryBytes_ > options_.maxMemoryBytes))
+    {
+        std::string path = lru_.back()->path;
+        erase(path);
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void StaticFileCache::clear()
+{
+    invalidations_.fetch_add(entries_.size(), std::memory_order_relaxed);
+    for (const auto &watch : watches_)
+    {
+        ::inotify_rm_watch(inotifyFd_, watch.first);
+    }
+    watches_.clear();
+    entries_.clear();
+    lru_.clear();
+    memoryBytes_ = 0;
+}
+
+void StaticFileCache::releaseWatch(int wd, const std::string &path)
+{
+    if (wd < 0)
+    {
+        return;
+    }
+    auto it = watches_.find(wd);
+    if (it != watches_.end())
+    {
+        std::vector<std::string> &paths = it->second;
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            if (paths[i] == path)
+            {
+                paths[i].swap(paths.back());
+                paths.pop_back();
+                break;
+            }
+        }
+        if (!paths.empty())
+        {
+            return; // 同一个inode还有其他路径在用
+        }
+        watches_.erase(it);
+    }
+    ::inotify_rm_watch(inotifyFd_, wd);
+}
+
+void StaticFileCache::handleInotify()
+{
+    alignas(struct inotify_event) char buf[4096];
+    for (;;)
+    {
+        ssize_t n = ::read(inotifyFd_, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+            {
+                LOG_ERROR << "StaticFileCache read inotify errno = " << errno;
+            }
+            break;
+        }
+        for (const char *p = buf; p < buf + n;)
+        {
+            const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                clear(); // 丢失了事件 不知道哪些项已经过期
+                continue;
+            }
+            auto it = watches_.find(event->wd);
+            if (it == watches_.end())
+            {
+                continue; // 已经删除的watch(IN_IGNORED等)
+            }
+            std::vector<std::string> paths;
+            paths.swap(it->second);
+            watches_.erase(it);
+            if (!(event->mask & IN_IGNORED))
+            {
+                ::inotify_rm_watch(inotifyFd_, event->wd);
+            }
+            for (const std::string &path : paths)
+            {
+                auto entry = entries_.find(path);
+                if (entry == entries_.end())
+                {
+                    continue;
+                }
+                entry->second.wd = -1; // watch已经删除
+                erase(path);
+                invalidations_.fetch_add(1, std::memory_order_relaxed);
+                LOG_DEBUG << "StaticFileCache invalidate " << path << " mask = " << event->mask;
+            }
+        }
+    }
+    updateStats();
+}
+
+void StaticFileCache::updateStats()
+{
+    numEntries_.store(entries_.size(), std::memory_order_relaxed);
+    statMemoryBytes_.store(memoryBytes_, std::memory_order_relaxed);
+}
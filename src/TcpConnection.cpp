@@ -0,0 +1,819 @@
+#include <TcpConnection.hpp>
+#include <Channel.hpp>
+#include <EventLoop.hpp>
+#include <Logger.hpp>
+#include <Socket.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    // 一次writev最多的段数
+    const int kMaxIov = 64;
+    // 新数据和输出队列的最后一块都不超过这个大小时合并成一块
+    const size_t kCoalesceSize = 4096;
+    // 一次可写事件中最多splice几轮(每轮最多一个管道容量) 避免一个连接长时间占住loop
+    const int kMaxSpliceRounds = 16;
+}
+
+void defaultConnectionCallback(const TcpConnectionPtr &conn)
+{
+    LOG_DEBUG << conn->localAddress().toIpPort() << " -> " << conn->peerAddress().toIpPort()
+              << " is " << (conn->connected() ? "UP" : "DOWN");
+}
+
+void defaultMessageCallback(const TcpConnectionPtr &, Buffer *buffer, Timestamp)
+{
+    buffer->retrieveAll();
+}
+
+TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg, int sockfd,
+                             const InetAddress &localAddr, const InetAddress &peerAddr)
+    : loop_(loop), name_(nameArg), state_(kConnecting), reading_(true), readPaused_(false),
+      overHighWaterMark_(false), waitingForSource_(false), peerHalfClosed_(false),
+      socket_(new Socket(sockfd)), channel_(new Channel(loop, sockfd)),
+      localAddr_(localAddr), peerAddr_(peerAddr),
+      highWaterMark_(kDefaultHighWaterMark), lowWaterMark_(0), pauseReadingOnHighWaterMark_(true),
+      outputOffset_(0), outputBytes_(0), pipeFds_{-1, -1}, pipeBytes_(0)
+{
+    // channel的回调在处理事件时tie住了连接 这里捕获this是安全的
+    channel_->setReadCallback([this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_->setWriteCallback([this]() { handleWrite(); });
+    channel_->setCloseCallback([this]() { handleClose(); });
+    channel_->setErrorCallback([this]() { handleError(); });
+    channel_->setHalfCloseCallback([this]() { handleHalfClose(); });
+    LOG_DEBUG << "TcpConnection::ctor[" << name_ << "] fd=" << sockfd;
+    socket_->setKeepAlive(true);
+    if (loop_->socketBusyPollUs() > 0)
+    {
+        EventLoop::setSocketBusyPoll(sockfd, loop_->socketBusyPollUs());
+    }
+}
+
+TcpConnection::~TcpConnection()
+{
+    LOG_DEBUG << "TcpConnection::dtor[" << name_ << "] fd=" << channel_->fd()
+              << " state=" << static_cast<int>(state_);
+    if (pipeFds_[0] >= 0)
+    {
+        ::close(pipeFds_[0]);
+        ::close(pipeFds_[1]);
+    }
+}
+
+void TcpConnection::send(const void *data, size_t len)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(static_cast<const char *>(data), len);
+    }
+    else
+    {
+        send(std::string(static_cast<const char *>(data), len));
+    }
+}
+
+void TcpConnection::send(std::string &&message)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(message.data(), message.size(), &message);
+    }
+    else
+    {
+        // shared_ptr加string放得下InlineFunction的内部存储 不额外分配
+        loop_->queueInLoop([self = shared_from_this(), message = std::move(message)]() mutable
+                           { self->sendInLoop(message.data(), message.size(), &message); });
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+    }
+    else
+    {
+        send(buf->retrieveAllAsString());
+    }
+}
+
+void TcpConnection::send(const SharedSlice &slice)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendSlicesInLoop(&slice, 1);
+    }
+    else
+    {
+        loop_->queueInLoop([self = shared_from_this(), slice]() { self->sendSlicesInLoop(&slice, 1); });
+    }
+}
+
+void TcpConnection::send(const std::vector<SharedSlice> &slices)
+{
+    if (state_ != kConnected || slices.empty())
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendSlicesInLoop(slices.data(), slices.size());
+    }
+    else
+    {
+        loop_->queueInLoop([self = shared_from_this(), slices]()
+                           { self->sendSlicesInLoop(slices.data(), slices.size()); });
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    FileHandlePtr file = FileHandle::dup(fd);
+    if (!file)
+    {
+        LOG_ERROR << "TcpConnection::sendFile " << name_ << " dup fd " << fd << " errno = " << errno;
+        return;
+    }
+    sendFile(file, offset, len);
+}
+
+void TcpConnection::sendFile(const FileHandlePtr &file, off_t offset, size_t len)
+{
+    if (state_ != kConnected || len == 0)
+    {
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendFileInLoop(file, offset, len);
+    }
+    else
+    {
+        loop_->queueInLoop([self = shared_from_this(), file, offset, len]()
+                           { self->sendFileInLoop(file, offset, len); });
+    }
+}
+
+void TcpConnection::sendInLoop(const char *data, size_t len, std::string *message)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "TcpConnection " << name_ << " disconnected, give up writing";
+        return;
+    }
+    size_t written = 0;
+    // 输出队列为空时直接写 大部分响应一次就能写完 不需要关注EPOLLOUT
+    if (!channel_->isWriting() && outputQueue_.empty())
+    {
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = len;
+        ssize_t n = writeDirect(&iov, 1, len);
+        if (n < 0)
+        {
+            return; // 连接已经不可用 等待关闭事件
+        }
+        written = static_cast<size_t>(n);
+    }
+    if (written == len)
+    {
+        return;
+    }
+    if (message != nullptr && written == 0)
+    {
+        appendOutput(data, len, message);
+    }
+    else
+    {
+        appendOutput(data + written, len - written, nullptr);
+    }
+    outputQueued();
+}
+
+void TcpConnection::sendSlicesInLoop(const SharedSlice *slices, size_t count)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "TcpConnection " << name_ << " disconnected, give up writing";
+        return;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        total += slices[i].size();
+    }
+    size_t written = 0;
+    if (total > 0 && !channel_->isWriting() && outputQueue_.empty())
+    {
+        struct iovec iov[kMaxIov];
+        int iovcnt = 0;
+        for (size_t i = 0; i < count && iovcnt < kMaxIov; ++i)
+        {
+            if (!slices[i].empty())
+            {
+                iov[iovcnt].iov_base = const_cast<char *>(slices[i].data());
+                iov[iovcnt].iov_len = slices[i].size();
+                ++iovcnt;
+            }
+        }
+        ssize_t n = writeDirect(iov, iovcnt, total);
+        if (n < 0)
+        {
+            return;
+        }
+        written = static_cast<size_t>(n);
+    }
+    if (written == total)
+    {
+        return;
+    }
+    // 跳过已经写出的部分 剩下的只把引用加入输出队列
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t size = slices[i].size();
+        if (written >= size)
+        {
+            written -= size;
+            continue;
+        }
+        appendOutput(written == 0 ? slices[i] : slices[i].subslice(written));
+        written = 0;
+    }
+    outputQueued();
+}
+
+void TcpConnection::sendFileInLoop(const FileHandlePtr &file, off_t offset, size_t len)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "TcpConnection " << name_ << " disconnected, give up writing";
+        return;
+    }
+    outputQueue_.emplace_back();
+    OutputChunk &chunk = outputQueue_.back();
+    chunk.file = file;
+    chunk.fileOffset = offset;
+    chunk.fileBytes = len;
+    // 前面没有待发送的数据时立即发送 小文件一次就能发完
+    if (!channel_->isWriting() && !waitingForSource_ && outputQueue_.size() == 1)
+    {
+        if (!writeFile(chunk))
+        {
+            return; // 连接已经关闭
+        }
+        if (outputQueue_.empty())
+        {
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop([self = shared_from_this()]() { self->writeCompleteCallback_(self); });
+            }
+            return;
+        }
+    }
+    outputQueued();
+}
+
+ssize_t TcpConnection::writeDirect(const struct iovec *iov, int count, size_t total)
+{
+    ssize_t n = count == 1 ? ::write(channel_->fd(), iov[0].iov_base, iov[0].iov_len)
+                           : ::writev(channel_->fd(), iov, count);
+    if (n >= 0)
+    {
+        if (static_cast<size_t>(n) == total && writeCompleteCallback_)
+        {
+            loop_->queueInLoop([self = shared_from_this()]() { self->writeCompleteCallback_(self); });
+        }
+        return n;
+    }
+    int savedErrno = errno;
+    if (savedErrno != EWOULDBLOCK && savedErrno != EINTR)
+    {
+        LOG_ERROR << "TcpConnection::sendInLoop " << name_ << " errno = " << savedErrno;
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void TcpConnection::outputQueued()
+{
+    if (!overHighWaterMark_ && outputBytes_ >= highWaterMark_)
+    {
+        overHighWaterMark_ = true;
+        if (highWaterMarkCallback_)
+        {
+            loop_->queueInLoop([self = shared_from_this(), bytes = outputBytes_]()
+                               { self->highWaterMarkCallback_(self, bytes); });
+        }
+        if (pauseReadingOnHighWaterMark_)
+        {
+            readPaused_ = true;
+            updateReading();
+        }
+    }
+    if (!channel_->isWriting() && !waitingForSource_)
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::appendOutput(const char *data, size_t len, std::string *message)
+{
+    outputBytes_ += len;
+    // 只能追加到自己持有的内存块 slice是共享的只读数据 文件块没有内存数据
+    if (len <= kCoalesceSize && !outputQueue_.empty() && outputQueue_.back().slice.empty() &&
+        !outputQueue_.back().isFile() && outputQueue_.back().owned.size() <= kCoalesceSize)
+    {
+        outputQueue_.back().owned.append(data, len);
+        return;
+    }
+    outputQueue_.emplace_back();
+    if (message != nullptr)
+    {
+        outputQueue_.back().owned = std::move(*message);
+    }
+    else
+    {
+        outputQueue_.back().owned.assign(data, len);
+    }
+}
+
+void TcpConnection::appendOutput(SharedSlice slice)
+{
+    outputBytes_ += slice.size();
+    outputQueue_.emplace_back();
+    outputQueue_.back().slice = std::move(slice);
+}
+
+bool TcpConnection::writeOutput()
+{
+    if (outputQueue_.front().isFile())
+    {
+        return writeFile(outputQueue_.front());
+    }
+    // 收集到下一个文件块为止的内存块
+    struct iovec iov[kMaxIov];
+    int count = 0;
+    size_t offset = outputOffset_;
+    for (auto it = outputQueue_.begin(); it != outputQueue_.end() && !it->isFile() && count < kMaxIov; ++it)
+    {
+        iov[count].iov_base = const_cast<char *>(it->data()) + offset;
+        iov[count].iov_len = it->size() - offset;
+        ++count;
+        offset = 0;
+    }
+    ssize_t n = ::writev(channel_->fd(), iov, count);
+    if (n < 0)
+    {
+        if (errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return true;
+        }
+        LOG_ERROR << "TcpConnection::writeOutput " << name_ << " errno = " << errno;
+        return false;
+    }
+    // 释放已经写完的块
+    size_t remain = static_cast<size_t>(n);
+    outputBytes_ -= remain;
+    while (remain > 0)
+    {
+        size_t front = outputQueue_.front().size() - outputOffset_;
+        if (remain < front)
+        {
+            outputOffset_ += remain;
+            break;
+        }
+        remain -= front;
+        outputQueue_.pop_front(); // slice的块在这里释放引用
+        outputOffset_ = 0;
+    }
+    return true;
+}
+
+bool TcpConnection::writeFile(OutputChunk &chunk)
+{
+    if (!chunk.file->isRegular())
+    {
+        return spliceFile(chunk);
+    }
+    off_t *offset = chunk.fileOffset >= 0 ? &chunk.fileOffset : nullptr;
+    ssize_t n = ::sendfile(channel_->fd(), chunk.file->fd(), offset, chunk.fileBytes);
+    if (n < 0)
+    {
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN || savedErrno == EINTR)
+        {
+            return true; // socket缓冲区满 等EPOLLOUT
+        }
+        LOG_ERROR << "TcpConnection::writeFile " << name_ << " sendfile errno = " << savedErrno;
+        handleClose();
+        return false;
+    }
+    if (n == 0)
+    {
+        LOG_ERROR << "TcpConnection::writeFile " << name_ << " file ended with " << chunk.fileBytes
+                  << " bytes unsent";
+        handleClose();
+        return false;
+    }
+    chunk.fileBytes -= static_cast<size_t>(n);
+    if (chunk.fileBytes == 0)
+    {
+        popFileChunk();
+    }
+    return true;
+}
+
+bool TcpConnection::spliceFile(OutputChunk &chunk)
+{
+    if (pipeFds_[0] < 0 && ::pipe2(pipeFds_, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR << "TcpConnection::spliceFile " << name_ << " pipe2 errno = " << errno;
+        handleClose();
+        return false;
+    }
+    for (int round = 0; round < kMaxSpliceRounds; ++round)
+    {
+        // 先把管道中的数据写到socket
+        if (pipeBytes_ > 0)
+        {
+            ssize_t n = ::splice(pipeFds_[0], nullptr, channel_->fd(), nullptr, pipeBytes_,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0)
+            {
+                int savedErrno = errno;
+                if (savedErrno == EAGAIN || savedErrno == EINTR)
+                {
+                    return true; // socket缓冲区满 等EPOLLOUT
+                }
+                LOG_ERROR << "TcpConnection::spliceFile " << name_ << " splice to socket errno = " << savedErrno;
+                handleClose();
+                return false;
+            }
+            pipeBytes_ -= static_cast<size_t>(n);
+            chunk.fileBytes -= static_cast<size_t>(n);
+            if (chunk.fileBytes == 0)
+            {
+                popFileChunk();
+                return true;
+            }
+            continue;
+        }
+        // 管道已经空了 从源读入下一段
+        off_t *offset = chunk.fileOffset >= 0 ? &chunk.fileOffset : nullptr;
+        ssize_t n = ::splice(chunk.file->fd(), offset, pipeFds_[1], nullptr, chunk.fileBytes,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n < 0)
+        {
+            int savedErrno = errno;
+            if (savedErrno == EINTR)
+            {
+                continue;
+            }
+            if (savedErrno == EAGAIN)
+            {
+                waitForSource(chunk.file->fd());
+                return true;
+            }
+            LOG_ERROR << "TcpConnection::spliceFile " << name_ << " splice from fd " << chunk.file->fd()
+                      << " errno = " << savedErrno;
+            handleClose();
+            return false;
+        }
+        if (n == 0)
+        {
+            LOG_ERROR << "TcpConnection::spliceFile " << name_ << " source ended with " << chunk.fileBytes
+                      << " bytes unsent";
+            handleClose();
+            return false;
+        }
+        pipeBytes_ += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void TcpConnection::popFileChunk()
+{
+    outputQueue_.pop_front();
+    if (sourceChannel_)
+    {
+        removeSourceChannel();
+    }
+}
+
+void TcpConnection::waitForSource(int fd)
+{
+    if (sourceChannel_ && sourceChannel_->fd() != fd)
+    {
+        removeSourceChannel();
+    }
+    if (!sourceChannel_)
+    {
+        sourceChannel_.reset(new Channel(loop_, fd));
+        sourceChannel_->setReadCallback([this](Timestamp) { sourceReadable(); });
+        sourceChannel_->setCloseCallback([this]() { sourceReadable(); }); // 写端关闭 splice会读到0
+        sourceChannel_->tie(shared_from_this());
+    }
+    waitingForSource_ = true;
+    if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+    sourceChannel_->enableReading();
+}
+
+void TcpConnection::sourceReadable()
+{
+    // 已经移除的channel在同一轮事件中仍可能被回调
+    if (!waitingForSource_)
+    {
+        return;
+    }
+    waitingForSource_ = false;
+    sourceChannel_->disableReading();
+    if (state_ != kDisconnected && !outputQueue_.empty())
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::removeSourceChannel()
+{
+    waitingForSource_ = false;
+    sourceChannel_->disableAll();
+    sourceChannel_->remove();
+    // 这一轮的活跃列表中可能还有它 等事件处理完再析构
+    loop_->queueInLoop([channel = std::move(sourceChannel_)]() {});
+}
+
+void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    int savedErrno = 0;
+    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (n > 0)
+    {
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+    else if (n == 0)
+    {
+        if (halfCloseCallback_)
+        {
+            handleHalfClose();
+        }
+        else
+        {
+            handleClose();
+        }
+    }
+    else if (savedErrno != EAGAIN && savedErrno != EINTR)
+    {
+        LOG_ERROR << "TcpConnection::handleRead " << name_ << " errno = " << savedErrno;
+        handleError();
+    }
+}
+
+void TcpConnection::handleWrite()
+{
+    if (!channel_->isWriting())
+    {
+        LOG_TRACE << "Connection fd = " << channel_->fd() << " is down, no more writing";
+        return;
+    }
+    if (!writeOutput())
+    {
+        return; // 出错 等待关闭事件
+    }
+    if (overHighWaterMark_ && outputBytes_ <= lowWaterMark_)
+    {
+        overHighWaterMark_ = false;
+        if (lowWaterMarkCallback_)
+        {
+            lowWaterMarkCallback_(shared_from_this(), outputBytes_);
+        }
+        if (readPaused_)
+        {
+            readPaused_ = false;
+            updateReading();
+        }
+    }
+    if (outputQueue_.empty())
+    {
+        channel_->disableWriting();
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop([self = shared_from_this()]() { self->writeCompleteCallback_(self); });
+        }
+        if (state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+}
+
+void TcpConnection::handleHalfClose()
+{
+    if (state_ == kDisconnected || peerHalfClosed_)
+    {
+        return; // 已经关闭或者已经处理过半关闭
+    }
+    if (!halfCloseCallback_)
+    {
+        return; // 由读回调read到0时关闭连接
+    }
+    // 对端的FIN之前的数据全部读完 之后不会再有数据
+    for (;;)
+    {
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+        if (n > 0)
+        {
+            messageCallback_(shared_from_this(), &inputBuffer_, loop_->pollReturnTime());
+            continue;
+        }
+        if (n < 0 && savedErrno == EINTR)
+        {
+            continue;
+        }
+        break;
+    }
+    if (state_ == kDisconnected)
+    {
+        return; // 消息回调中关闭了连接
+    }
+    // 水平触发下半关闭状态会一直通知 不再关注读事件
+    peerHalfClosed_ = true;
+    reading_ = false;
+    updateReading();
+    if (state_ == kConnected)
+    {
+        halfCloseCallback_(shared_from_this());
+    }
+    else
+    {
+        // 本端已经调用过shutdown 输出队列继续发送 写完关闭写端后关闭连接
+        shutdownInLoop();
+    }
+}
+
+void TcpConnection::handleClose()
+{
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    LOG_DEBUG << "TcpConnection::handleClose fd=" << channel_->fd() << " state=" << static_cast<int>(state_);
+    setState(kDisconnected);
+    channel_->disableAll();
+    if (sourceChannel_)
+    {
+        removeSourceChannel();
+    }
+
+    TcpConnectionPtr guard(shared_from_this());
+    connectionCallback_(guard);
+    closeCallback_(guard); // 执行的是TcpServer::removeConnection
+}
+
+void TcpConnection::handleError()
+{
+    int err = Socket::getSocketError(channel_->fd());
+    LOG_ERROR << "TcpConnection::handleError name:" << name_ << " SO_ERROR:" << err;
+}
+
+void TcpConnection::shutdown()
+{
+    int expected = kConnected;
+    if (state_.compare_exchange_strong(expected, kDisconnecting))
+    {
+        loop_->runInLoop([self = shared_from_this()]() { self->shutdownInLoop(); });
+    }
+}
+
+void TcpConnection::shutdownInLoop()
+{
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    // 输出队列写完之后由handleWrite再次调用
+    if (!channel_->isWriting() && outputQueue_.empty())
+    {
+        socket_->shutdownWrite();
+        // 对端也已经关闭了写端 读写事件都不再关注 channel已经不在epoll中 不会再收到EPOLLHUP
+        if (peerHalfClosed_)
+        {
+            handleClose();
+        }
+    }
+}
+
+void TcpConnection::forceClose()
+{
+    int state = state_;
+    if (state == kConnected || state == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop([self = shared_from_this()]() { self->forceCloseInLoop(); });
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::setTcpNoDelay(bool on)
+{
+    socket_->setTcpNoDelay(on);
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop([self = shared_from_this()]()
+                     {
+                         self->reading_ = true;
+                         self->updateReading();
+                     });
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop([self = shared_from_this()]()
+                     {
+                         self->reading_ = false;
+                         self->updateReading();
+                     });
+}
+
+void TcpConnection::updateReading()
+{
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+    // 对端半关闭后socket一直可读(EOF) 水平触发下再关注读事件会让loop空转 之后startRead也不再恢复
+    bool want = reading_ && !readPaused_ && !peerHalfClosed_;
+    if (want && !channel_->isReading())
+    {
+        channel_->enableReading();
+    }
+    else if (!want && channel_->isReading())
+    {
+        channel_->disableReading();
+    }
+}
+
+void TcpConnection::connectEstablished()
+{
+    setState(kConnected);
+    channel_->tie(shared_from_this());
+    updateReading();
+    connectionCallback_(shared_from_this());
+}
+
+void TcpConnection::connectDestroyed()
+{
+    if (state_ == kConnected)
+    {
+        setState(kDisconnected);
+        channel_->disableAll();
+        connectionCallback_(shared_from_this());
+    }
+    if (sourceChannel_)
+    {
+        removeSourceChannel();
+    }
+    channel_->remove();
+}
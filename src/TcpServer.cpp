@@ -0,0 +1,71 @@
+#include <TcpServer.hpp>
+#include <Acceptor.hpp>
+#include <EventLoop.hpp>
+#include <Logger.hpp>
+#include <TcpConnection.hpp>
+
+TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+                     Option option)
+    : loop_(loop), ipPort_(listenAddr.toIpPort()), name_(nameArg),
+      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      threadPool_(new EventLoopThreadPool(loop, name_)),
+      connectionCallback_(defaultConnectionCallback), messageCallback_(defaultMessageCallback),
+      highWaterMark_(TcpConnection::kDefaultHighWaterMark), lowWaterMark_(0),
+      started_(0), nextConnId_(1)
+{
+    acceptor_->setNewConnectionCallback([this](int sockfd, const InetAddress &peerAddr)
+                                        { newConnection(sockfd, peerAddr); });
+}
+
+TcpServer::~TcpServer()
+{
+    LOG_DEBUG << "TcpServer::~TcpServer [" << name_ << "] destructing";
+    for (auto &item : connections_)
+    {
+        TcpConnectionPtr conn(std::move(item.second));
+        // 连接可能还在subloop中处理事件 在它自己的loop中销毁channel
+        conn->getLoop()->runInLoop([conn]() { conn->connectDestroyed(); });
+    }
+}
+
+void TcpServer::start()
+{
+    if (started_.fetch_add(1) == 0)
+    {
+        threadPool_->start(threadInitCallback_);
+        loop_->runInLoop([this]() { acceptor_->listen(); });
+    }
+}
+
+void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
+{
+    EventLoop *ioLoop = threadPool_->getLoopForPeer(peerAddr.getSockAddr());
+    std::string connName = name_ + "-" + ipPort_ + "#" + std::to_string(nextConnId_++);
+    LOG_DEBUG << "TcpServer::newConnection [" << name_ << "] - new connection [" << connName
+              << "] from " << peerAddr.toIpPort();
+
+    TcpConnectionPtr conn = std::make_shared<TcpConnection>(ioLoop, connName, sockfd,
+                                                            InetAddress::localAddress(sockfd), peerAddr);
+    connections_[connName] = conn;
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setHalfCloseCallback(halfCloseCallback_);
+    conn->setHighWaterMarkCallback(highWaterMarkCallback_, highWaterMark_);
+    conn->setLowWaterMarkCallback(lowWaterMarkCallback_, lowWaterMark_);
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) { removeConnection(c); });
+    ioLoop->runInLoop([conn]() { conn->connectEstablished(); });
+}
+
+void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+{
+    loop_->runInLoop([this, conn]() { removeConnectionInLoop(conn); });
+}
+
+void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+{
+    LOG_DEBUG << "TcpServer::removeConnectionInLoop [" << name_ << "] - connection " << conn->name();
+    connections_.erase(conn->name());
+    // 当前可能正在subloop的Channel::handleEvent中 放到队列里 等这次事件处理完再移除channel
+    conn->getLoop()->queueInLoop([conn]() { conn->connectDestroyed(); });
+}
@@ -0,0 +1,65 @@
+#include <Thread.hpp>
+#include <CurrentThread.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+
+std::atomic_int Thread::numCreated_(0);
+
+Thread::Thread(ThreadFunc func, const std::string &name)
+    : started_(false), joined_(false), tid_(0), func_(std::move(func)),
+      name_(name)
+{
+    setDefaultName();
+}
+
+Thread::~Thread()
+{
+    // 线程已经启动但没有join 分离线程 由系统回收资源
+    if (started_ && !joined_)
+    {
+        thread_->detach();
+    }
+}
+
+void Thread::start()
+{
+    started_ = true;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool ready = false;
+
+    thread_ = std::shared_ptr<std::thread>(new std::thread([&]()
+    {
+        // 获取线程tid 通知start()返回 解锁之后不能再访问start()栈上的变量
+        // 所以notify也要在锁内完成
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tid_ = CurrentThread::tid();
+            ready = true;
+            cond.notify_one();
+        }
+        // 内核线程名最长15个字节
+        ::pthread_setname_np(::pthread_self(), name_.substr(0, 15).c_str());
+        func_();
+    }));
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&ready]() { return ready; });
+}
+
+void Thread::join()
+{
+    joined_ = true;
+    thread_->join();
+}
+
+void Thread::setDefaultName()
+{
+    int num = ++numCreated_;
+    if (name_.empty())
+    {
+        name_ = "Thread" + std::to_string(num);
+    }
+}
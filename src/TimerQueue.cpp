@@ -0,0 +1,380 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include <limits>
+
+#include <EventLoop.hpp>
+#include <Logger.hpp>
+#include <TimerQueue.hpp>
+
+std::atomic<int64_t> TimerQueue::s_numCreated_(0);
+
+// timerfd未设置时armedExpiration_的取值
+static const int64_t kNotArmed = std::numeric_limits<int64_t>::max();
+
+/**
+ * 创建timerfd 使用CLOCK_MONOTONIC 系统时间的跳变不影响定时器
+ * TFD_NONBLOCK 非阻塞  TFD_CLOEXEC fork后exec时自动关闭
+ **/
+static int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL << "timerfd_create error:" << errno;
+    }
+    return timerfd;
+}
+
+// 秒 => 微秒 负数按0处理
+static int64_t toMicroseconds(double seconds)
+{
+    if (seconds <= 0.0)
+    {
+        return 0;
+    }
+    return static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+}
+
+int64_t TimerQueue::monotonicMicroseconds()
+{
+    // CLOCK_MONOTONIC走vDSO 不会陷入内核
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond +
+           ts.tv_nsec / 1000;
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop), timerfd_(createTimerfd()), timerfdChannel_(loop, timerfd_),
+      armedExpiration_(kNotArmed), activeCount_(0), staleEntries_(0),
+      callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    // 系统时间只用来换算出还要等多久 之后全部在单调时钟上计算
+    double delay = static_cast<double>(when.microSecondsSinceEpoch() -
+                                       Timestamp::now().microSecondsSinceEpoch()) /
+                   Timestamp::kMicroSecondsPerSecond;
+    return addTimerAfter(std::move(cb), delay, interval);
+}
+
+TimerId TimerQueue::addTimerAfter(TimerCallback cb, double delay, double interval)
+{
+    int64_t expiration = monotonicMicroseconds() + toMicroseconds(delay);
+    int64_t intervalUs = toMicroseconds(interval);
+    int64_t sequence = s_numCreated_.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // 绝大多数定时器(请求超时)在loop线程中添加 直接插入 不经过任务队列
+    if (loop_->isInLoopThread())
+    {
+        int slot = insertInLoop(std::move(cb), expiration, intervalUs, sequence, false);
+        return TimerId(slot, sequence);
+    }
+    // 其他线程添加时槽位还未分配 由loop线程插入后在foreignTimers_中登记
+    loop_->queueInLoop(
+        [this, cb = std::move(cb), expiration, intervalUs, sequence]() mutable
+        {
+            insertInLoop(std::move(cb), expiration, intervalUs, sequence, true);
+        });
+    return TimerId(-1, sequence);
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    if (!timerId.valid())
+    {
+        return;
+    }
+    // slot_ == -1 说明添加操作可能还在任务队列中 cancel同样入队 保证排在添加之后执行
+    if (loop_->isInLoopThread() && timerId.slot_ >= 0)
+    {
+        cancelInLoop(timerId);
+    }
+    else
+    {
+        loop_->queueInLoop([this, timerId]()
+                           { cancelInLoop(timerId); });
+    }
+}
+
+int TimerQueue::insertInLoop(TimerCallback cb, int64_t expiration,
+                             int64_t interval, int64_t sequence, bool foreign)
+{
+    uint32_t slot;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(timers_.size());
+        timers_.push_back(Timer{nullptr, 0, 0, 0, false, false});
+    }
+
+    Timer &timer = timers_[slot];
+    timer.callback = std::move(cb);
+    timer.interval = interval;
+    timer.sequence = sequence;
+    timer.armed = true;
+    timer.foreign = foreign;
+    if (foreign)
+    {
+        foreignTimers_[sequence] = slot;
+    }
+    ++activeCount_;
+
+    pushHeap(HeapEntry{expiration, slot, timer.generation});
+    // 只有新定时器早于timerfd当前的到期时间才需要timerfd_settime
+    // 执行到期回调期间添加的定时器由handleRead结束时统一设置
+    if (!callingExpiredTimers_ && expiration < armedExpiration_)
+    {
+        resetTimerfd(expiration);
+    }
+    return static_cast<int>(slot);
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId)
+{
+    uint32_t slot;
+    if (timerId.slot_ >= 0)
+    {
+        slot = static_cast<uint32_t>(timerId.slot_);
+    }
+    else
+    {
+        auto it = foreignTimers_.find(timerId.sequence_);
+        if (it == foreignTimers_.end())
+        {
+            return;
+        }
+        slot = it->second;
+    }
+
+    // 槽位已被释放或复用 说明定时器已经到期或者被取消过了
+    if (slot >= timers_.size() || timers_[slot].sequence != timerId.sequence_)
+    {
+        return;
+    }
+    if (timers_[slot].armed)
+    {
+        ++staleEntries_;
+    }
+    releaseSlot(slot);
+
+    if (staleEntries_ >= kCompactThreshold && staleEntries_ * 2 > heap_.size())
+    {
+        compactHeap();
+    }
+}
+
+void TimerQueue::releaseSlot(uint32_t slot)
+{
+    Timer &timer = timers_[slot];
+    if (timer.foreign)
+    {
+        foreignTimers_.erase(timer.sequence);
+    }
+    timer.callback = nullptr; // 及时释放回调捕获的资源
+    timer.sequence = 0;
+    timer.armed = false;
+    timer.foreign = false;
+    ++timer.generation;
+    freeSlots_.push_back(slot);
+    --activeCount_;
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany = 0;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof(howmany));
+    if (n != sizeof(howmany))
+    {
+        LOG_ERROR << "TimerQueue::handleRead() reads " << n << " bytes instead of 8";
+    }
+    armedExpiration_ = kNotArmed; // timerfd已经触发 当前处于未设置状态
+
+    int64_t now = monotonicMicroseconds();
+    // 先把所有到期的定时器取出来 再统一执行 回调中添加的定时器不会在本轮被执行
+    expired_.clear();
+    while (!heap_.empty() && heap_[0].expiration <= now)
+    {
+        HeapEntry entry = heap_[0];
+        popHeap();
+        if (isStale(entry))
+        {
+            --staleEntries_;
+            continue;
+        }
+        timers_[entry.slot].armed = false;
+        expired_.push_back(entry);
+    }
+
+    callingExpiredTimers_ = true;
+    for (const HeapEntry &entry : expired_)
+    {
+        // 可能已被本轮前面的回调取消
+        if (isStale(entry))
+        {
+            continue;
+        }
+        // 回调中可能添加定时器导致timers_扩容 所以先把回调移出来再执行
+        TimerCallback cb = std::move(timers_[entry.slot].callback);
+        cb();
+
+        // 回调中取消了自身
+        if (isStale(entry))
+        {
+            continue;
+        }
+        Timer &timer = timers_[entry.slot];
+        if (timer.interval > 0)
+        {
+            timer.callback = std::move(cb);
+            timer.armed = true;
+            pushHeap(HeapEntry{now + timer.interval, entry.slot, entry.generation});
+        }
+        else
+        {
+            releaseSlot(entry.slot);
+        }
+    }
+    callingExpiredTimers_ = false;
+    expired_.clear();
+
+    rearm();
+}
+
+void TimerQueue::rearm()
+{
+    while (!heap_.empty() && isStale(heap_[0]))
+    {
+        popHeap();
+        --staleEntries_;
+    }
+    if (!heap_.empty() && heap_[0].expiration < armedExpiration_)
+    {
+        resetTimerfd(heap_[0].expiration);
+    }
+}
+
+void TimerQueue::resetTimerfd(int64_t expiration)
+{
+    // 绝对时间 it_value全0表示关闭timerfd 所以至少设置为1微秒
+    if (expiration <= 0)
+    {
+        expiration = 1;
+    }
+    struct itimerspec newValue;
+    ::memset(&newValue, 0, sizeof(newValue));
+    newValue.it_value.tv_sec =
+        static_cast<time_t>(expiration / Timestamp::kMicroSecondsPerSecond);
+    newValue.it_value.tv_nsec = static_cast<long>(
+        (expiration % Timestamp::kMicroSecondsPerSecond) * 1000);
+    if (::timerfd_settime(timerfd_, TFD_TIMER_ABSTIME, &newValue, nullptr) < 0)
+    {
+        LOG_ERROR << "timerfd_settime error:" << errno;
+        return;
+    }
+    armedExpiration_ = expiration;
+}
+
+void TimerQueue::pushHeap(const HeapEntry &entry)
+{
+    heap_.push_back(entry);
+    siftUp(heap_.size() - 1);
+}
+
+void TimerQueue::popHeap()
+{
+    heap_[0] = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty())
+    {
+        siftDown(0);
+    }
+}
+
+// 上浮 空穴法 减少一半的拷贝
+void TimerQueue::siftUp(size_t index)
+{
+    HeapEntry entry = heap_[index];
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / kArity;
+        if (heap_[parent].expiration <= entry.expiration)
+        {
+            break;
+        }
+        heap_[index] = heap_[parent];
+        index = parent;
+    }
+    heap_[index] = entry;
+}
+
+// 下沉 每层在连续的4个孩子中找最小值
+void TimerQueue::siftDown(size_t index)
+{
+    const size_t size = heap_.size();
+    HeapEntry entry = heap_[index];
+    while (true)
+    {
+        size_t first = index * kArity + 1;
+        if (first >= size)
+        {
+            break;
+        }
+        size_t last = first + kArity < size ? first + kArity : size;
+        size_t smallest = first;
+        for (size_t child = first + 1; child < last; ++child)
+        {
+            if (heap_[child].expiration < heap_[smallest].expiration)
+            {
+                smallest = child;
+            }
+        }
+        if (entry.expiration <= heap_[smallest].expiration)
+        {
+            break;
+        }
+        heap_[index] = heap_[smallest];
+        index = smallest;
+    }
+    heap_[index] = entry;
+}
+
+void TimerQueue::compactHeap()
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < heap_.size(); ++i)
+    {
+        if (!isStale(heap_[i]))
+        {
+            heap_[kept++] = heap_[i];
+        }
+    }
+    heap_.resize(kept);
+    staleEntries_ = 0;
+    // 自底向上建堆 O(n)
+    if (kept > 1)
+    {
+        for (size_t i = (kept - 2) / kArity + 1; i-- > 0;)
+        {
+            siftDown(i);
+        }
+    }
+}
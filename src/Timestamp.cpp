@@ -1,4 +1,26 @@
 #include <Timestamp.hpp>
+
+#include <cstring>
+
+namespace
+{
+    // "00".."99" 每次查表写两位数字
+    const char kDigitPairs[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    thread_local time_t t_lastSecond = -1; // t_date对应的秒数
+    thread_local char t_date[64];          // "2025/08/26 16:29:10" 只用前19个字符
+
+    inline void writeTwoDigits(char *p, int value)
+    {
+        memcpy(p, kDigitPairs + value * 2, 2);
+    }
+} // namespace
+
 Timestamp Timestamp::now()
 {
     struct timeval tv;
@@ -14,34 +36,44 @@ Timestamp Timestamp::now()
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
-    snprintf(buf, 128, "%4d/%02d/%02d  %02d:%02d:%02d", tm_time->tm_year + 1900,
-             tm_time->tm_mon + 1, tm_time->tm_mday, tm_time->tm_hour,
-             tm_time->tm_min, tm_time->tm_sec);
+    time_t seconds = secondsSinceEpoch();
+    struct tm tm_time;
+    localtime_r(&seconds, &tm_time);
+    snprintf(buf, 128, "%4d/%02d/%02d  %02d:%02d:%02d", tm_time.tm_year + 1900,
+             tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_hour,
+             tm_time.tm_min, tm_time.tm_sec);
     return buf;
 }
 // 2025/08/26 16:29:10
-// 20250826 16:29:10.773804
+// 2025/08/26 16:29:10.773804
 std::string Timestamp::toFormattedString(bool showMicroseconds) const
 {
-    char buf[64] = {0};
-    time_t seconds =
-        static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
-    // 使用localtime函数将秒数格式化成日历时间
-    tm *tm_time = localtime(&seconds);
-    if (showMicroseconds)
+    char buf[kFormattedSize];
+    return std::string(buf, formatTo(buf, showMicroseconds));
+}
+
+size_t Timestamp::formatTo(char *buf, bool showMicroseconds) const
+{
+    time_t seconds = secondsSinceEpoch();
+    if (seconds != t_lastSecond)
     {
-        int microseconds =
-            static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
-        snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d.%06d",
-                 tm_time->tm_year + 1900, tm_time->tm_mon + 1, tm_time->tm_mday,
-                 tm_time->tm_hour, tm_time->tm_min, tm_time->tm_sec, microseconds);
+        // 每个线程每秒最多一次 localtime_r可重入 不会像localtime那样共用静态结果
+        struct tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        snprintf(t_date, sizeof(t_date), "%4d/%02d/%02d %02d:%02d:%02d",
+                 tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                 tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+        t_lastSecond = seconds;
     }
-    else
+    memcpy(buf, t_date, 19);
+    if (!showMicroseconds)
     {
-        snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d",
-                 tm_time->tm_year + 1900, tm_time->tm_mon + 1, tm_time->tm_mday,
-                 tm_time->tm_hour, tm_time->tm_min, tm_time->tm_sec);
+        return 19;
     }
-    return buf;
+    int microseconds = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+    buf[19] = '.';
+    writeTwoDigits(buf + 20, microseconds / 10000);
+    writeTwoDigits(buf + 22, microseconds / 100 % 100);
+    writeTwoDigits(buf + 24, microseconds % 100);
+    return kFormattedSize;
 }
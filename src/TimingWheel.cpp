@@ -0,0 +1,157 @@
+#include <TimingWheel.hpp>
+
+// 向上取整为2的幂 这样取槽下标只需要一次按位与
+static size_t roundUpPowerOfTwo(int n)
+{
+    size_t size = 1;
+    while (size < static_cast<size_t>(n))
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+TimingWheel::Entry::~Entry()
+{
+    // 连接对象析构时自动从时间轮中摘除 避免悬空指针
+    if (wheel_)
+    {
+        wheel_->remove(this);
+    }
+}
+
+TimingWheel::TimingWheel(int tickMs, int slots)
+    : tickUs_(static_cast<int64_t>(tickMs > 0 ? tickMs : 1) * 1000),
+      slots_(roundUpPowerOfTwo(slots > 0 ? slots : 1)),
+      mask_(slots_.size() - 1),
+      currentTick_(Timestamp::now().microSecondsSinceEpoch() / tickUs_),
+      expiredTick_(currentTick_), size_(0)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    // 剩余的Entry属于各自的连接对象 这里只断开它们与时间轮的关系
+    for (Node &slot : slots_)
+    {
+        while (slot.linked())
+        {
+            Entry *entry = static_cast<Entry *>(slot.next_);
+            unlink(entry);
+            entry->wheel_ = nullptr;
+        }
+    }
+}
+
+void TimingWheel::add(Entry *entry, double timeout)
+{
+    if (entry->wheel_)
+    {
+        remove(entry);
+    }
+    // 向上取整 再加上已经过去了一部分的当前tick 保证不会早于timeout超时
+    int64_t timeoutUs = static_cast<int64_t>(timeout * 1000 * 1000);
+    int64_t ticks = timeoutUs > 0 ? (timeoutUs + tickUs_ - 1) / tickUs_ : 0;
+    entry->timeoutTicks_ = ticks + 1;
+    entry->deadline_ = currentTick_ + entry->timeoutTicks_;
+    entry->wheel_ = this;
+    link(entry);
+    ++size_;
+}
+
+void TimingWheel::remove(Entry *entry)
+{
+    if (entry->wheel_ != this)
+    {
+        return;
+    }
+    unlink(entry);
+    entry->wheel_ = nullptr;
+    --size_;
+}
+
+void TimingWheel::updateTime(Timestamp now)
+{
+    int64_t nowTick = now.microSecondsSinceEpoch() / tickUs_;
+    // 系统时间回拨时保持不动 等时间追上来
+    if (nowTick > currentTick_)
+    {
+        currentTick_ = nowTick;
+    }
+}
+
+void TimingWheel::advance(Timestamp now)
+{
+    // 先更新当前tick 回调中新加入或touch的Entry基于最新的时间计算截止tick
+    updateTime(now);
+    if (currentTick_ <= expiredTick_)
+    {
+        return;
+    }
+    // 一次最多转一圈 转一圈已经能访问到所有的槽
+    int64_t elapsed = currentTick_ - expiredTick_;
+    int64_t slots = static_cast<int64_t>(slots_.size());
+    int64_t first = elapsed > slots ? currentTick_ - slots + 1 : expiredTick_ + 1;
+    int64_t last = currentTick_;
+    expiredTick_ = last;
+    for (int64_t tick = first; tick <= last; ++tick)
+    {
+        expireSlot(static_cast<size_t>(tick) & mask_);
+    }
+}
+
+void TimingWheel::link(Entry *entry)
+{
+    Node *head = &slots_[static_cast<size_t>(entry->deadline_) & mask_];
+    entry->prev_ = head->prev_;
+    entry->next_ = head;
+    head->prev_->next_ = entry;
+    head->prev_ = entry;
+}
+
+void TimingWheel::unlink(Node *node)
+{
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = node;
+    node->next_ = node;
+}
+
+void TimingWheel::expireSlot(size_t index)
+{
+    Node &head = slots_[index];
+    if (!head.linked())
+    {
+        return;
+    }
+    // 把整个槽先摘到局部链表上 逐个取出处理
+    // 回调中可能remove局部链表中的其他Entry 因为是双向链表 摘除总是安全的
+    Node pending;
+    pending.next_ = head.next_;
+    pending.prev_ = head.prev_;
+    pending.next_->prev_ = &pending;
+    pending.prev_->next_ = &pending;
+    head.prev_ = &head;
+    head.next_ = &head;
+
+    while (pending.linked())
+    {
+        Entry *entry = static_cast<Entry *>(pending.next_);
+        unlink(entry);
+        if (entry->deadline_ > currentTick_)
+        {
+            // 被touch推后了 或者还需要再转几圈 挂到新的槽上
+            link(entry);
+            continue;
+        }
+        entry->wheel_ = nullptr;
+        --size_;
+        if (entry->callback_)
+        {
+            // 回调可能析构Entry所在的连接对象 连同callback_本身 所以拷贝一份再执行
+            // 超时是少数情况 这里的拷贝不在touch的热路径上 执行之后不能再访问entry
+            ExpireCallback cb = entry->callback_;
+            cb();
+        }
+    }
+}
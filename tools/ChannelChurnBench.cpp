@@ -0,0 +1,203 @@
+/**
+ * Channel注册/修改/删除的开销基准 K个eventfd上的channel 每个阶段输出每个channel的平均耗时
+ * 用法: ChannelChurnBench [K=10000]   WEBSERVER_POLLER=io_uring 时测io_uring后端
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 每个阶段分别在两种模式下运行:
+ *   immediate loop开始之前调用 每次enable/disable立即提交给poller(epoll_ctl)
+ *   deferred  在loop的任务中调用 变更记入待更新列表 计时包括下一次poll之前的统一提交
+ * 阶段:
+ *   register  新建channel并enableReading
+ *   modify    enableWriting后马上disableWriting(写了一次就写完) 延迟提交时两次变更相互抵消
+ *   lookup    hasChannel 即fd索引的扁平表查找 重复10次
+ *   remove    disableAll后remove
+ *   churn     同一个回调中完成以上全部(短连接) 延迟提交时不产生系统调用
+ **/
+#include <Channel.hpp>
+#include <EventLoop.hpp>
+
+#include <chrono>
+#include <errno.h>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using ChannelPtr = std::unique_ptr<Channel>;
+
+    const int kLookupRounds = 10;
+
+    struct Bench
+    {
+        EventLoop *loop;
+        std::vector<int> fds;
+        std::vector<ChannelPtr> channels;
+        bool found = true;
+
+        void registerAll()
+        {
+            for (int fd : fds)
+            {
+                channels.emplace_back(new Channel(loop, fd));
+                channels.back()->enableReading();
+            }
+        }
+        void modifyAll()
+        {
+            for (ChannelPtr &channel : channels)
+            {
+                channel->enableWriting();
+                channel->disableWriting();
+            }
+        }
+        void lookupAll()
+        {
+            for (int round = 0; round < kLookupRounds; ++round)
+            {
+                for (ChannelPtr &channel : channels)
+                {
+                    found = loop->hasChannel(channel.get()) && found;
+                }
+            }
+        }
+        void removeAll()
+        {
+            for (ChannelPtr &channel : channels)
+            {
+                channel->disableAll();
+                channel->remove();
+            }
+            channels.clear();
+        }
+        void churnAll()
+        {
+            for (int fd : fds)
+            {
+                Channel channel(loop, fd);
+                channel.enableReading();
+                channel.enableWriting();
+                channel.disableWriting();
+                channel.disableAll();
+                channel.remove();
+            }
+        }
+    };
+
+    // 每个channel的平均耗时(ns)
+    double perChannel(Clock::duration elapsed, size_t count)
+    {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / count;
+    }
+
+    double runImmediate(const std::function<void()> &phase, size_t count)
+    {
+        Clock::time_point start = Clock::now();
+        phase();
+        return perChannel(Clock::now() - start, count);
+    }
+
+    // 在loop的任务中执行phase 在其后入队的任务中停止计时 此时本轮的变更已经在poll之前提交
+    double runDeferred(EventLoop *loop, const std::function<void()> &phase, size_t count)
+    {
+        double result = 0;
+        Clock::time_point start;
+        loop->queueInLoop([loop, &phase, &start, &result, count]()
+                          {
+                              start = Clock::now();
+                              phase();
+                              loop->queueInLoop([loop, &start, &result, count]()
+                                                {
+                                                    result = perChannel(Clock::now() - start, count);
+                                                    loop->quit();
+                                                });
+                          });
+        loop->loop();
+        return result;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? ::atoi(argv[1]) : 10000;
+    if (count <= 0)
+    {
+        ::fprintf(stderr, "usage: %s [K]\n", argv[0]);
+        return 2;
+    }
+    struct rlimit rl;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    EventLoop loop;
+    Bench bench;
+    bench.loop = &loop;
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0)
+        {
+            ::fprintf(stderr, "ChannelChurnBench: eventfd #%d: %s (raise ulimit -n)\n", i, strerror(errno));
+            return 1;
+        }
+        bench.fds.push_back(fd);
+    }
+
+    struct Phase
+    {
+        const char *name;
+        std::function<void()> run;
+        size_t ops;
+    };
+    size_t k = bench.fds.size();
+    Phase phases[] = {
+        {"register", [&bench]()
+         { bench.registerAll(); },
+         k},
+        {"modify", [&bench]()
+         { bench.modifyAll(); },
+         k},
+        {"lookup", [&bench]()
+         { bench.lookupAll(); },
+         k * kLookupRounds},
+        {"remove", [&bench]()
+         { bench.removeAll(); },
+         k},
+        {"churn", [&bench]()
+         { bench.churnAll(); },
+         k},
+    };
+
+    ::printf("%d channels\n", count);
+    const size_t numPhases = sizeof(phases) / sizeof(phases[0]);
+    std::vector<double> immediate(numPhases);
+    for (size_t i = 0; i < numPhases; ++i)
+    {
+        immediate[i] = runImmediate(phases[i].run, phases[i].ops);
+    }
+    for (size_t i = 0; i < numPhases; ++i)
+    {
+        double deferred = runDeferred(&loop, phases[i].run, phases[i].ops);
+        ::printf("%-9s immediate %8.1f ns   deferred %8.1f ns\n", phases[i].name, immediate[i], deferred);
+    }
+
+    for (int fd : bench.fds)
+    {
+        ::close(fd);
+    }
+    if (!bench.found)
+    {
+        ::fprintf(stderr, "ChannelChurnBench: hasChannel missed a registered channel\n");
+        return 1;
+    }
+    return 0;
+}
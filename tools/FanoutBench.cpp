@@ -0,0 +1,236 @@
+/**
+ * 广播/扇出基准 同一条1KB消息发给所有连接 比较按字符串发送(每个连接各拷贝一份)和SharedSlice(只拷贝一次)
+ * 用法: FanoutBench [轮数=20] [连接数=10000] [端口=9981]   需要ulimit -n大于连接数
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 两种方式各在一个子进程中运行(copy用端口port slice用port+1) 互不影响内存统计:
+ *   服务端 TcpServer + 4个subloop的EventLoopThreadPool 连接建立后由一个非loop线程发布消息
+ *          copy: conn->send(msg)  slice: SharedSlice::copyFrom(msg)一次 再conn->send(slice)
+ *   客户端 fork出的进程 通过回环地址建立所有连接 接收缓冲区设为8KB 用epoll读完全部数据后通知服务端
+ * 输出: 从开始发布到客户端收齐的时间 这段时间服务端进程的CPU时间 以及服务端RSS峰值的增长
+ * 客户端收得慢 大部分消息会积压在连接的输出队列中 这部分内存就是两种方式的差别
+ **/
+#include <EventLoop.hpp>
+#include <SharedSlice.hpp>
+#include <TcpConnection.hpp>
+#include <TcpServer.hpp>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <mutex>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    const size_t kMessageSize = 1024;
+    const int kServerThreads = 4;
+    const int kClientRecvBuffer = 8192;
+
+    struct Options
+    {
+        int rounds;
+        int conns;
+        int port;
+    };
+
+    // 客户端进程 建立conns个连接 读完rounds轮消息后向doneFd写一个字节 然后等待被kill
+    void runClient(const Options &options, int port, int doneFd)
+    {
+        int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (int i = 0; i < options.conns; ++i)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            int size = kClientRecvBuffer;
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+            if (fd < 0 || ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0)
+            {
+                ::perror("FanoutBench client: connect");
+                ::_exit(1);
+            }
+            struct epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        }
+
+        const long long expected = static_cast<long long>(options.conns) * kMessageSize * options.rounds;
+        long long received = 0;
+        static char buf[64 * 1024];
+        struct epoll_event events[256];
+        while (received < expected)
+        {
+            int n = ::epoll_wait(epfd, events, 256, -1);
+            for (int i = 0; i < n; ++i)
+            {
+                ssize_t len = ::read(events[i].data.fd, buf, sizeof(buf));
+                if (len > 0)
+                {
+                    received += len;
+                }
+            }
+        }
+        char done = 1;
+        ::write(doneFd, &done, 1);
+        ::pause();
+        ::_exit(0);
+    }
+
+    double cpuSeconds()
+    {
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+
+    long maxRssKb()
+    {
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // 服务端进程 useSlice决定发布的方式
+    void runServer(bool useSlice, const Options &options, int port)
+    {
+        int doneFds[2];
+        if (::pipe(doneFds) < 0)
+        {
+            ::perror("FanoutBench: pipe");
+            ::_exit(1);
+        }
+
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(static_cast<uint16_t>(port), "127.0.0.1"), "fanout");
+        std::mutex mutex;
+        std::vector<TcpConnectionPtr> conns;
+        server.setConnectionCallback([&mutex, &conns](const TcpConnectionPtr &conn)
+                                     {
+                                         if (conn->connected())
+                                         {
+                                             conn->setTcpNoDelay(true);
+                                             std::lock_guard<std::mutex> lock(mutex);
+                                             conns.push_back(conn);
+                                         }
+                                     });
+        server.setThreadNum(kServerThreads);
+        server.start();
+
+        pid_t client = ::fork();
+        if (client == 0)
+        {
+            runClient(options, port, doneFds[1]);
+        }
+
+        std::thread publisher([&]()
+                              {
+                                  for (;;)
+                                  {
+                                      {
+                                          std::lock_guard<std::mutex> lock(mutex);
+                                          if (static_cast<int>(conns.size()) == options.conns)
+                                          {
+                                              break;
+                                          }
+                                      }
+                                      ::usleep(10 * 1000);
+                                  }
+
+                                  const std::string message(kMessageSize, 'x');
+                                  long rssBefore = maxRssKb();
+                                  double cpuBefore = cpuSeconds();
+                                  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                                  for (int round = 0; round < options.rounds; ++round)
+                                  {
+                                      if (useSlice)
+                                      {
+                                          SharedSlice slice = SharedSlice::copyFrom(message);
+                                          for (const TcpConnectionPtr &conn : conns)
+                                          {
+                                              conn->send(slice);
+                                          }
+                                      }
+                                      else
+                                      {
+                                          for (const TcpConnectionPtr &conn : conns)
+                                          {
+                                              conn->send(message);
+                                          }
+                                      }
+                                  }
+                                  char done;
+                                  ::read(doneFds[0], &done, 1);
+                                  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                                  ::printf("%-5s %d conns x %d rounds x %zu B   wall %.3f s   server cpu %.3f s   peak rss +%.1f MB\n",
+                                           useSlice ? "slice" : "copy", options.conns, options.rounds, kMessageSize, wall,
+                                           cpuSeconds() - cpuBefore, (maxRssKb() - rssBefore) / 1024.0);
+                                  ::fflush(stdout);
+
+                                  ::kill(client, SIGKILL);
+                                  ::waitpid(client, nullptr, 0);
+                                  conns.clear();
+                                  loop.quit();
+                              });
+        loop.loop();
+        publisher.join();
+        // 结果已经输出 不再逐个拆除上万个连接
+        ::_exit(0);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    options.rounds = argc > 1 ? ::atoi(argv[1]) : 20;
+    options.conns = argc > 2 ? ::atoi(argv[2]) : 10000;
+    options.port = argc > 3 ? ::atoi(argv[3]) : 9981;
+    if (options.rounds <= 0 || options.conns <= 0 || options.port <= 0 || options.port >= 65535)
+    {
+        ::fprintf(stderr, "usage: %s [rounds] [conns] [port]\n", argv[0]);
+        return 2;
+    }
+    struct rlimit rl;
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < static_cast<rlim_t>(options.conns) + 64)
+    {
+        ::fprintf(stderr, "FanoutBench: need ulimit -n >= %d (now %ld)\n", options.conns + 64,
+                  static_cast<long>(rl.rlim_cur));
+        return 1;
+    }
+
+    int ret = 0;
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            runServer(mode == 1, options, options.port + mode);
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ::fprintf(stderr, "FanoutBench: %s run failed (status %d)\n", mode == 1 ? "slice" : "copy", status);
+            ret = 1;
+        }
+    }
+    return ret;
+}
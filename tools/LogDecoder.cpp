@@ -0,0 +1,173 @@
+/**
+ * 二进制日志解码工具 把AsynLogging::setBinaryOutput(true)写出的日志文件还原成文本
+ * 用法: LogDecoder file...  结果输出到标准输出
+ * 每个文件都是自包含的(文件头+用到的调用点定义) 可以单独解码 也可以按顺序一起解码
+ **/
+#include <BinaryLog.hpp>
+
+#include <errno.h>
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // 从文件中读到的调用点定义 字符串由这里持有 site中的指针指向它们
+    struct DecodedSite
+    {
+        std::string file;
+        std::string format;
+        std::string argTypes;
+        std::unique_ptr<BinaryLogSite> site;
+    };
+
+    bool readFile(const char *path, std::vector<char> &data)
+    {
+        FILE *fp = ::fopen(path, "rb");
+        if (fp == nullptr)
+        {
+            ::fprintf(stderr, "LogDecoder: cannot open %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        char buf[64 * 1024];
+        size_t n;
+        while ((n = ::fread(buf, 1, sizeof(buf), fp)) > 0)
+        {
+            data.insert(data.end(), buf, buf + n);
+        }
+        ::fclose(fp);
+        return true;
+    }
+
+    // 解码一个文件 返回是否完整解码
+    bool decodeFile(const char *path)
+    {
+        std::vector<char> data;
+        if (!readFile(path, data))
+        {
+            return false;
+        }
+        std::map<uint32_t, DecodedSite> sites; // 调用点定义只在所在文件内有效
+        std::string line;
+        size_t pos = 0;
+        bool first = true;
+        while (pos + 8 <= data.size())
+        {
+            uint32_t header[2];
+            ::memcpy(header, &data[pos], sizeof(header));
+            uint32_t len = header[0];
+            uint32_t kind = header[1];
+            if (len > data.size() - pos - 8)
+            {
+                ::fprintf(stderr, "LogDecoder: %s: truncated record at offset %zu\n", path, pos);
+                return false;
+            }
+            const char *payload = &data[pos + 8];
+            pos += 8 + len;
+
+            if (first)
+            {
+                first = false;
+                if (kind != BinaryLog::kMagicRecord || len != sizeof(BinaryLog::kFileMagic) ||
+                    ::memcmp(payload, BinaryLog::kFileMagic, len) != 0)
+                {
+                    ::fprintf(stderr, "LogDecoder: %s is not a binary log file\n", path);
+                    return false;
+                }
+                continue;
+            }
+
+            switch (kind)
+            {
+            case BinaryLog::kTextRecord:
+                ::fwrite(payload, 1, len, stdout);
+                break;
+            case BinaryLog::kSiteRecord:
+            {
+                int32_t fields[3];
+                if (len < sizeof(fields))
+                {
+                    break;
+                }
+                ::memcpy(fields, payload, sizeof(fields));
+                // 三个以'\0'结尾的字符串
+                const char *p = payload + sizeof(fields);
+                const char *end = payload + len;
+                const char *strings[3];
+                int found = 0;
+                for (; found < 3 && p < end; ++found)
+                {
+                    strings[found] = p;
+                    p += strnlen(p, end - p) + 1;
+                }
+                if (found < 3 || p > end)
+                {
+                    ::fprintf(stderr, "LogDecoder: %s: bad call site record\n", path);
+                    break;
+                }
+                DecodedSite &decoded = sites[static_cast<uint32_t>(fields[0])];
+                decoded.file = strings[0];
+                decoded.format = strings[1];
+                decoded.argTypes = strings[2];
+                int level = fields[1];
+                if (level < 0 || level >= Logger::LEVEL_COUNT)
+                {
+                    level = Logger::INFO;
+                }
+                decoded.site.reset(new BinaryLogSite(static_cast<Logger::LogLevel>(level),
+                                                     decoded.file.c_str(), fields[2],
+                                                     decoded.format.c_str()));
+                decoded.site->argTypes = decoded.argTypes.c_str();
+                break;
+            }
+            case BinaryLog::kBinaryRecord:
+            {
+                BinaryLog::RecordHeader record;
+                if (len < sizeof(record))
+                {
+                    break;
+                }
+                ::memcpy(&record, payload, sizeof(record));
+                auto it = sites.find(record.siteId);
+                line.clear();
+                BinaryLog::formatRecord(it == sites.end() ? nullptr : it->second.site.get(),
+                                        record, payload + sizeof(record), len - sizeof(record), line);
+                ::fwrite(line.data(), 1, line.size(), stdout);
+                break;
+            }
+            case BinaryLog::kMagicRecord:
+                break;
+            default:
+                ::fprintf(stderr, "LogDecoder: %s: unknown record kind %u\n", path, kind);
+                break;
+            }
+        }
+        if (pos != data.size())
+        {
+            ::fprintf(stderr, "LogDecoder: %s: %zu trailing bytes\n", path, data.size() - pos);
+            return false;
+        }
+        return true;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        ::fprintf(stderr, "usage: %s binary-log-file...\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!decodeFile(argv[i]))
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
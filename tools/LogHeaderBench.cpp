@@ -0,0 +1,96 @@
+/**
+ * 日志头部开销基准 日志头部为时间(精确到微秒)和tid 如"2025/08/26 16:29:10.773804  1234 "
+ * 用法: LogHeaderBench [行数=2000000]
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 输出每行的平均耗时(ns):
+ *   legacy header 原来的做法 每行Timestamp::now + localtime + 两次snprintf
+ *                 没有设置TZ环境变量时glibc的localtime每次都会检查/etc/localtime 这是主要开销
+ *   cached header Timestamp::formatTo(每个线程每秒一次localtime_r 微秒查表)加上缓存的tid字符串
+ *   LOG_INFO line 完整的LOG_INFO << "x" 输出到什么都不做的OutputFunc
+ **/
+#ifndef OPEN_LOGGING
+#define OPEN_LOGGING
+#endif
+#include <CurrentThread.hpp>
+#include <Logger.hpp>
+#include <Timestamp.hpp>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 防止编译器把格式化的结果当作无用代码删掉
+    volatile size_t g_result;
+
+    double nanosPerLine(Clock::time_point start, size_t lines)
+    {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()) / lines;
+    }
+
+    // 原来Logger::Impl::formatTime的做法 tid按"%5d "格式化
+    size_t legacyHeader(char *buf, size_t size)
+    {
+        Timestamp now = Timestamp::now();
+        time_t seconds = static_cast<time_t>(now.secondsSinceEpoch());
+        int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+        struct tm *tm_time = ::localtime(&seconds);
+        int len = ::snprintf(buf, size, "%4d/%02d/%02d %02d:%02d:%02d", tm_time->tm_year + 1900,
+                             tm_time->tm_mon + 1, tm_time->tm_mday, tm_time->tm_hour,
+                             tm_time->tm_min, tm_time->tm_sec);
+        len += ::snprintf(buf + len, size - len, ".%06d %5d ", microseconds, CurrentThread::tid());
+        return static_cast<size_t>(len);
+    }
+
+    size_t cachedHeader(char *buf)
+    {
+        size_t len = Timestamp::now().formatTo(buf, true);
+        buf[len++] = ' ';
+        CurrentThread::tid();
+        memcpy(buf + len, CurrentThread::tidString(), CurrentThread::tidStringLength());
+        return len + CurrentThread::tidStringLength();
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t lines = argc > 1 ? static_cast<size_t>(::atol(argv[1])) : 2000000;
+    if (lines == 0)
+    {
+        ::fprintf(stderr, "usage: %s [lines]\n", argv[0]);
+        return 2;
+    }
+    char buf[128];
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < lines; ++i)
+    {
+        g_result = legacyHeader(buf, sizeof(buf));
+    }
+    ::printf("legacy header %8.1f ns/line   %.*s\n", nanosPerLine(start, lines),
+             static_cast<int>(g_result), buf);
+
+    start = Clock::now();
+    for (size_t i = 0; i < lines; ++i)
+    {
+        g_result = cachedHeader(buf);
+    }
+    ::printf("cached header %8.1f ns/line   %.*s\n", nanosPerLine(start, lines),
+             static_cast<int>(g_result), buf);
+
+    Logger::setLogLevel(Logger::INFO);
+    Logger::setOutput([](const char *, int len)
+                      { g_result = len; });
+    start = Clock::now();
+    for (size_t i = 0; i < lines; ++i)
+    {
+        LOG_INFO << "x";
+    }
+    ::printf("LOG_INFO line %8.1f ns/line\n", nanosPerLine(start, lines));
+    return 0;
+}
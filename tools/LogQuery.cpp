@@ -0,0 +1,192 @@
+/**
+ * 按时间段查询日志 用AsynLogging::setTimeIndex生成的时间索引(LogIndex.hpp)只读取时间范围重叠的块
+ * 用法: LogQuery "2026/10/17 04:33:00" "2026/10/17 04:33:30[.500000]" file...
+ * file可以是日志文件xxx.log 也可以是LogCompressor压缩后的xxx.log.gz 索引为同名加".idx"
+ * 文件用mmap读取 .gz只解压命中的gzip member 没有索引的文件整个扫描
+ * 按文件和块的顺序输出时间在[from, to]之内的行 行首没有时间的行(多行日志的后续行)跟随前一行
+ **/
+#include <LogIndex.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+    struct Range
+    {
+        int64_t from;
+        int64_t to;
+    };
+
+    // 输出data中时间在range之内的行
+    void filterLines(const char *data, size_t len, const Range &range, LogIndex::TimeParser &parser)
+    {
+        bool keep = false;
+        const char *end = data + len;
+        for (const char *line = data; line < end;)
+        {
+            const char *eol = static_cast<const char *>(::memchr(line, '\n', end - line));
+            eol = eol ? eol + 1 : end;
+            int64_t micros = 0;
+            if (parser.parse(line, eol - line, &micros))
+            {
+                keep = micros >= range.from && micros <= range.to;
+            }
+            if (keep)
+            {
+                ::fwrite(line, 1, eol - line, stdout);
+            }
+            line = eol;
+        }
+    }
+
+    // 解压data中连续的gzip member
+    bool inflateBlock(const char *data, size_t len, std::string &out)
+    {
+        z_stream stream;
+        ::memset(&stream, 0, sizeof(stream));
+        if (::inflateInit2(&stream, 15 + 16) != Z_OK)
+        {
+            return false;
+        }
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        stream.avail_in = static_cast<uInt>(len);
+        char buf[64 * 1024];
+        int ret = Z_OK;
+        while (stream.avail_in > 0)
+        {
+            stream.next_out = reinterpret_cast<Bytef *>(buf);
+            stream.avail_out = sizeof(buf);
+            ret = ::inflate(&stream, Z_NO_FLUSH);
+            out.append(buf, sizeof(buf) - stream.avail_out);
+            if (ret == Z_STREAM_END)
+            {
+                ::inflateReset(&stream); // 下一个member
+            }
+            else if (ret != Z_OK)
+            {
+                break;
+            }
+        }
+        ::inflateEnd(&stream);
+        return ret == Z_OK || ret == Z_STREAM_END;
+    }
+
+    // 查询一个文件 返回是否成功
+    bool queryFile(const char *path, const Range &range)
+    {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            ::fprintf(stderr, "LogQuery: cannot open %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::fprintf(stderr, "LogQuery: stat %s failed: %s\n", path, strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        void *map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+            ::fprintf(stderr, "LogQuery: mmap %s failed: %s\n", path, strerror(errno));
+            return false;
+        }
+        const char *data = static_cast<const char *>(map);
+
+        std::vector<LogIndex::Entry> entries;
+        if (!LogIndex::load(std::string(path) + LogIndex::kSuffix, &entries) || entries.empty())
+        {
+            // 没有索引 整个文件作为一块
+            entries.assign(1, LogIndex::Entry{0, INT64_MIN, INT64_MAX});
+        }
+        else if (entries[0].offset > 0)
+        {
+            // 索引之前的部分(比如没开索引时写的)不知道时间
+            entries.insert(entries.begin(), LogIndex::Entry{0, INT64_MIN, INT64_MAX});
+        }
+        size_t pathLen = ::strlen(path);
+        bool compressed = pathLen > 3 && ::strcmp(path + pathLen - 3, ".gz") == 0;
+        LogIndex::TimeParser parser;
+        std::string text;
+        bool ok = true;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const LogIndex::Entry &entry = entries[i];
+            size_t begin = static_cast<size_t>(entry.offset);
+            size_t end = i + 1 < entries.size() ? static_cast<size_t>(entries[i + 1].offset) : size;
+            if (entry.maxTime < range.from || entry.minTime > range.to || begin >= end || end > size)
+            {
+                continue;
+            }
+            if (!compressed)
+            {
+                filterLines(data + begin, end - begin, range, parser);
+                continue;
+            }
+            text.clear();
+            if (!inflateBlock(data + begin, end - begin, text))
+            {
+                ::fprintf(stderr, "LogQuery: %s: corrupt gzip data at offset %zu\n", path, begin);
+                ok = false;
+            }
+            filterLines(text.data(), text.size(), range, parser);
+        }
+        ::munmap(map, size);
+        return ok;
+    }
+
+    // 没有给出微秒时 结束时间包括这一整秒
+    bool parseTime(const char *arg, bool end, int64_t *micros)
+    {
+        LogIndex::TimeParser parser;
+        size_t len = ::strlen(arg);
+        if (!parser.parse(arg, len, micros))
+        {
+            return false;
+        }
+        if (end && ::strchr(arg, '.') == nullptr)
+        {
+            *micros += 999999;
+        }
+        return true;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Range range;
+    if (argc < 4 || !parseTime(argv[1], false, &range.from) ||
+        !parseTime(argv[2], true, &range.to))
+    {
+        ::fprintf(stderr, "usage: %s \"YYYY/mm/dd HH:MM:SS[.uuuuuu]\" \"YYYY/mm/dd HH:MM:SS[.uuuuuu]\" file...\n",
+                  argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!queryFile(argv[i], range))
+        {
+            ret = 1;
+        }
+    }
+    return ret;
+}
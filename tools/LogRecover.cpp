@@ -0,0 +1,45 @@
+/**
+ * 崩溃日志恢复工具 从AsynLogging::setCrashSafeBuffers(true)留下的映射文件(basename.ring.N)中
+ * 取出进程崩溃前还没有写入日志文件的日志
+ * 用法: LogRecover ring-file...  文本日志输出到标准输出 不修改也不删除映射文件
+ * 二进制日志记录需要崩溃进程的调用点登记表 无法还原 只在标准错误中给出条数
+ * 注意: 下次以相同basename启动的AsynLogging会自动取出这些日志并删除映射文件
+ **/
+#include <BinaryLog.hpp>
+#include <SpscRing.hpp>
+
+#include <stdio.h>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        ::fprintf(stderr, "usage: %s ring-file...\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        size_t binaryRecords = 0;
+        long count = SpscRing::recover(argv[i], [&binaryRecords](const char *data, size_t len, uint32_t kind)
+                                       {
+                                           if (kind == BinaryLog::kTextRecord)
+                                           {
+                                               ::fwrite(data, 1, len, stdout);
+                                           }
+                                           else
+                                           {
+                                               ++binaryRecords;
+                                           }
+                                       });
+        if (count < 0)
+        {
+            ::fprintf(stderr, "LogRecover: %s is not a log ring file\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+        ::fprintf(stderr, "LogRecover: %s: %ld records, %zu binary records skipped\n",
+                  argv[i], count, binaryRecords);
+    }
+    return ret;
+}
@@ -0,0 +1,147 @@
+/**
+ * LogStream各个operator<<的微基准 每种类型单独循环 与snprintf格式化同样的值对比
+ * 用法: LogStreamBench [每种类型的次数=5000000]
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 类型: int int64 double pointer string_view(以GeneralTemplate(data, len)输出)
+ *       以及一条4个字段的典型日志 "fd=.. bytes=.. ratio=.. conn=.."
+ * 输入值预先生成(位数/长度各不相同)并循环使用 缓冲区将满时reset 输出每次操作的平均耗时(ns)
+ **/
+#include <LogStream.hpp>
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const size_t kValues = 1024; // 2的幂 下标取模只需要按位与
+    const size_t kReserve = 128; // 缓冲区剩余不足时reset 一次操作最多写这么多
+
+    struct Inputs
+    {
+        std::vector<int> ints;
+        std::vector<int64_t> int64s;
+        std::vector<double> doubles;
+        std::vector<const void *> pointers;
+        std::vector<std::string> strings;
+        std::vector<std::string_view> views;
+    };
+
+    Inputs makeInputs()
+    {
+        Inputs in;
+        uint64_t x = 88172645463325252ULL;
+        for (size_t i = 0; i < kValues; ++i)
+        {
+            // xorshift 位数从1位到满位都有
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            int shift = static_cast<int>(i % 64);
+            in.ints.push_back(static_cast<int>(static_cast<int64_t>(x) >> (32 + shift % 32)));
+            in.int64s.push_back(static_cast<int64_t>(x) >> shift);
+            in.doubles.push_back(static_cast<double>(x % 1000000007) / (1 + i % 977));
+            in.pointers.push_back(reinterpret_cast<const void *>(x & 0x7fffffffffffULL));
+            in.strings.push_back(std::string(1 + i % 48, static_cast<char>('a' + i % 26)));
+        }
+        for (const std::string &s : in.strings)
+        {
+            in.views.push_back(s);
+        }
+        return in;
+    }
+
+    // 返回每次操作的平均耗时 op(i)用第i个输入值执行一次操作 返回值累加到bytes中
+    template <typename Op>
+    double measure(size_t iterations, size_t &bytes, Op &&op)
+    {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            bytes += op(i & (kValues - 1));
+        }
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()) / iterations;
+    }
+
+    // 缓冲区将满时清空 返回当前长度的最低位 只用于让结果被用到
+    size_t used(LogStream &stream)
+    {
+        size_t n = stream.buffer().length();
+        if (stream.buffer().avail() < kReserve)
+        {
+            stream.reset_buffer();
+        }
+        return n & 1;
+    }
+
+    void report(const char *name, double streamNs, double snprintfNs)
+    {
+        ::printf("%-12s LogStream %7.1f ns   snprintf %7.1f ns   %5.1fx\n", name, streamNs, snprintfNs,
+                 streamNs > 0 ? snprintfNs / streamNs : 0.0);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t iterations = argc > 1 ? static_cast<size_t>(::atol(argv[1])) : 5000000;
+    if (iterations == 0)
+    {
+        ::fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+    const Inputs in = makeInputs();
+    LogStream stream;
+    char buf[kReserve];
+    size_t bytes = 0;
+
+    report("int",
+           measure(iterations, bytes, [&](size_t i)
+                   { stream << in.ints[i]; return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   { return ::snprintf(buf, sizeof(buf), "%d", in.ints[i]); }));
+    report("int64",
+           measure(iterations, bytes, [&](size_t i)
+                   { stream << in.int64s[i]; return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   { return ::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(in.int64s[i])); }));
+    // snprintf用原来LogStream的格式"%.12g" LogStream输出最短的可以精确还原的形式
+    report("double",
+           measure(iterations, bytes, [&](size_t i)
+                   { stream << in.doubles[i]; return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   { return ::snprintf(buf, sizeof(buf), "%.12g", in.doubles[i]); }));
+    report("pointer",
+           measure(iterations, bytes, [&](size_t i)
+                   { stream << in.pointers[i]; return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   { return ::snprintf(buf, sizeof(buf), "%p", in.pointers[i]); }));
+    report("string_view",
+           measure(iterations, bytes, [&](size_t i)
+                   {
+                       std::string_view view = in.views[i];
+                       stream << GeneralTemplate(view.data(), static_cast<int>(view.size()));
+                       return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   {
+                       std::string_view view = in.views[i];
+                       return ::snprintf(buf, sizeof(buf), "%.*s", static_cast<int>(view.size()), view.data()); }));
+    report("4-field line",
+           measure(iterations, bytes, [&](size_t i)
+                   {
+                       stream << "fd=" << in.ints[i] << " bytes=" << in.int64s[i]
+                              << " ratio=" << in.doubles[i] << " conn=" << in.pointers[i];
+                       return used(stream); }),
+           measure(iterations, bytes, [&](size_t i)
+                   { return ::snprintf(buf, sizeof(buf), "fd=%d bytes=%lld ratio=%.12g conn=%p", in.ints[i],
+                                       static_cast<long long>(in.int64s[i]), in.doubles[i], in.pointers[i]); }));
+
+    // 输出累加的结果 保证上面的格式化不会被优化掉
+    ::printf("(checksum %zu)\n", bytes & 0xff);
+    return 0;
+}
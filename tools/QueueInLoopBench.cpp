@@ -0,0 +1,107 @@
+/**
+ * queueInLoop吞吐量基准 P个生产者线程同时向同一个EventLoop投递任务 P依次为1/2/4/8/16
+ * 用法: QueueInLoopBench [每轮任务总数=2000000]
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 每轮的任务总数固定 平均分给P个生产者 任务只在loop线程中给计数加一
+ * 输出:
+ *   total   从生产者开始投递到loop执行完最后一个任务的时间 折算成每秒执行的任务数
+ *   enqueue 生产者一侧每次queueInLoop的平均耗时(含分配节点和必要时write eventfd)
+ **/
+#include <EventLoop.hpp>
+#include <EventLoopThread.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    int64_t nanosSince(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    void runRound(EventLoop *loop, int producers, size_t total)
+    {
+        size_t perProducer = total / producers;
+        total = perProducer * producers;
+
+        size_t executed = 0; // 只在loop线程中访问
+        std::promise<void> done;
+        std::future<void> finished = done.get_future();
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+        std::vector<int64_t> enqueueNs(producers);
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                                     ready.fetch_add(1);
+                                     while (!go.load(std::memory_order_acquire))
+                                     {
+                                         std::this_thread::yield();
+                                     }
+                                     Clock::time_point start = Clock::now();
+                                     for (size_t i = 0; i < perProducer; ++i)
+                                     {
+                                         loop->queueInLoop([&executed, &done, total]()
+                                                           {
+                                                               if (++executed == total)
+                                                               {
+                                                                   done.set_value();
+                                                               }
+                                                           });
+                                     }
+                                     enqueueNs[p] = nanosSince(start);
+                                 });
+        }
+        while (ready.load() < producers)
+        {
+            std::this_thread::yield();
+        }
+        Clock::time_point start = Clock::now();
+        go.store(true, std::memory_order_release);
+        finished.wait();
+        int64_t elapsed = nanosSince(start);
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+
+        int64_t enqueueSum = 0;
+        for (int64_t ns : enqueueNs)
+        {
+            enqueueSum += ns;
+        }
+        ::printf("producers %2d   total %7.2f Mops/s (%6.1f ns/task)   enqueue %7.1f ns/op\n",
+                 producers, static_cast<double>(total) * 1000 / elapsed,
+                 static_cast<double>(elapsed) / total,
+                 static_cast<double>(enqueueSum) / total);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t total = argc > 1 ? static_cast<size_t>(::atol(argv[1])) : 2000000;
+    if (total < 16)
+    {
+        ::fprintf(stderr, "usage: %s [tasks-per-round>=16]\n", argv[0]);
+        return 2;
+    }
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+    for (int producers : {1, 2, 4, 8, 16})
+    {
+        runRound(loop, producers, total);
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+/**
+ * 定时器微基准 在同样的N个超时上比较TimerQueue(4叉堆+timerfd)和TimingWheel(哈希时间轮)
+ * 用法: TimerBench [N=1000000]
+ * 编译方式与其他工具相同: 和src、log目录下的全部源文件一起编译 -O2 -lpthread -lz
+ * 四个阶段 每个阶段输出两者每次操作的线程CPU时间(ns):
+ *   add     加入N个30~60秒的超时(连接空闲超时的典型分布)
+ *   refresh 每个超时刷新一次(连接读到数据): TimerQueue为cancel+runAfter TimingWheel为touch
+ *   remove  全部取消(连接关闭)
+ *   expire  加入N个200ms内陆续到期的超时并等全部触发 TimerQueue走真实的timerfd和loop
+ *           TimingWheel用1ms的tick 手动按1ms推进时间 不计等待时间 只计处理到期的CPU时间
+ * 结束时检查所有定时器和Entry都触发了 且没有Entry早于自己的timeout超时 否则返回1
+ **/
+#include <EventLoop.hpp>
+#include <TimingWheel.hpp>
+#include <Timestamp.hpp>
+
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+namespace
+{
+    // 本线程的CPU时间 单位纳秒 不含loop阻塞等待timerfd的时间
+    int64_t threadCpuNs()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+    }
+
+    // 伪随机的超时时长 [base, base + span) 两个实现用同一个序列
+    double timeoutOf(size_t i, double base, double span)
+    {
+        uint64_t x = (i + 1) * 0x9E3779B97F4A7C15ULL;
+        x ^= x >> 29;
+        return base + span * static_cast<double>(x % 1000000) / 1000000;
+    }
+
+    void report(const char *phase, size_t n, int64_t queueNs, int64_t wheelNs)
+    {
+        ::printf("%-8s TimerQueue %8.1f ns/op   TimingWheel %8.1f ns/op   %6.1fx\n", phase,
+                 static_cast<double>(queueNs) / n, static_cast<double>(wheelNs) / n,
+                 wheelNs > 0 ? static_cast<double>(queueNs) / wheelNs : 0.0);
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t n = argc > 1 ? static_cast<size_t>(::atol(argv[1])) : 1000000;
+    if (n == 0)
+    {
+        ::fprintf(stderr, "usage: %s [N]\n", argv[0]);
+        return 2;
+    }
+
+    EventLoop loop;
+    std::vector<TimerId> ids(n);
+    std::unique_ptr<TimingWheel::Entry[]> entries(new TimingWheel::Entry[n]);
+    TimingWheel wheel; // 1秒的tick 与EventLoop里的相同
+    size_t fired = 0;
+    int64_t start;
+
+    // add
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        ids[i] = loop.runAfter(timeoutOf(i, 30, 30), [&fired]()
+                               { ++fired; });
+    }
+    int64_t queueNs = threadCpuNs() - start;
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        entries[i].setCallback([&fired]()
+                               { ++fired; });
+        wheel.add(&entries[i], timeoutOf(i, 30, 30));
+    }
+    report("add", n, queueNs, threadCpuNs() - start);
+
+    // refresh
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        loop.cancel(ids[i]);
+        ids[i] = loop.runAfter(timeoutOf(i, 30, 30), [&fired]()
+                               { ++fired; });
+    }
+    queueNs = threadCpuNs() - start;
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        entries[i].touch();
+    }
+    report("refresh", n, queueNs, threadCpuNs() - start);
+
+    // remove
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        loop.cancel(ids[i]);
+    }
+    queueNs = threadCpuNs() - start;
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        wheel.remove(&entries[i]);
+    }
+    report("remove", n, queueNs, threadCpuNs() - start);
+
+    // expire 计时包含加入 两边都要从空开始建立N个超时
+    fired = 0;
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        loop.runAfter(timeoutOf(i, 0.001, 0.2), [&fired, &loop, n]()
+                      {
+                          if (++fired == n)
+                          {
+                              loop.quit();
+                          }
+                      });
+    }
+    loop.loop();
+    queueNs = threadCpuNs() - start;
+    size_t queueFired = fired;
+
+    // 同时检查超时时长是下限 每个Entry超时时经过的时间不能少于它的timeout
+    fired = 0;
+    size_t early = 0;
+    TimingWheel fineWheel(1, 512);
+    int64_t nowUs = Timestamp::now().microSecondsSinceEpoch();
+    const int64_t addedUs = nowUs;
+    fineWheel.advance(Timestamp(nowUs));
+    for (size_t i = 0; i < n; ++i)
+    {
+        int64_t timeoutUs = static_cast<int64_t>(timeoutOf(i, 0.001, 0.2) * 1000 * 1000);
+        entries[i].setCallback([&fired, &early, &nowUs, addedUs, timeoutUs]()
+                               {
+                                   ++fired;
+                                   if (nowUs - addedUs < timeoutUs)
+                                   {
+                                       ++early;
+                                   }
+                               });
+    }
+    start = threadCpuNs();
+    for (size_t i = 0; i < n; ++i)
+    {
+        fineWheel.add(&entries[i], timeoutOf(i, 0.001, 0.2));
+    }
+    while (!fineWheel.empty())
+    {
+        nowUs += 1000;
+        fineWheel.advance(Timestamp(nowUs));
+    }
+    report("expire", n, queueNs, threadCpuNs() - start);
+
+    if (queueFired != n || fired != n || early != 0)
+    {
+        ::fprintf(stderr, "TimerBench: fired %zu/%zu timers and %zu/%zu entries, %zu entries early\n",
+                  queueFired, n, fired, n, early);
+        return 1;
+    }
+    return 0;
+}